@@ -0,0 +1,134 @@
+/*
+ * bench_bitpack.c - Compression ratio and encode/decode speed of bitpack.c.
+ *
+ * A column of a million ints is generated for each of several value
+ * distributions, from narrow signed values (the signed-width case) through
+ * large values with small noise (the frame-of-reference case) to random 32-bit
+ * values that cannot be compressed. Each is encoded and decoded repeatedly and
+ * the best time is kept. Speeds are in GB/s of uncompressed ints, next to
+ * memcpy of the same buffer for scale, and the decoded column is compared with
+ * the input. The kernels run at the ISA level cpu_isa.c picks; BITS_ISA=scalar
+ * gives the scalar fallback.
+ *
+ * Build: gcc -O2 -o bench_bitpack bench_bitpack.c bitpack.c cpu_isa.c
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bitpack.h"
+
+#define VALUES (1 << 20) /* ints per column */
+#define RUNS 15          /* timed runs, best kept */
+
+enum distribution {
+  NARROW,
+  OFFSET,
+  MEDIUM,
+  RANDOM,
+  SPARSE,
+  DISTRIBUTIONS
+};
+
+static const char *const DISTRIBUTION_NAMES[DISTRIBUTIONS] = {
+    "int8", "1e6+uint12", "int20", "int32", "sparse"};
+
+static double seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// xorshift64*, so columns are the same on every run
+static uint32_t next_random(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return (uint32_t)((*state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void fill(int *values, enum distribution distribution) {
+  uint64_t state = 1;
+
+  for (size_t i = 0; i < VALUES; i++) {
+    uint32_t r = next_random(&state);
+
+    switch (distribution) {
+    case NARROW:
+      values[i] = (int8_t)r;
+      break;
+    case OFFSET:
+      values[i] = 1000000 + (int)(r & 4095);
+      break;
+    case MEDIUM:
+      values[i] = (int)(r << 12) >> 12;
+      break;
+    case RANDOM:
+      values[i] = (int)r;
+      break;
+    default:
+      // One nonzero value in 64
+      values[i] = (r % 64 == 0) ? (int)(r >> 20) : 0;
+      break;
+    }
+  }
+}
+
+int main(void) {
+  int *in = malloc(VALUES * sizeof(int));
+  int *out = malloc(VALUES * sizeof(int));
+  uint8_t *encoded = malloc(BITPACK_BOUND(VALUES));
+  const double gigabytes = (double)(VALUES * sizeof(int)) / 1e9;
+
+  if (in == NULL || out == NULL || encoded == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  printf("distribution,ratio,encode_gbps,decode_gbps,memcpy_gbps\n");
+  for (int distribution = 0; distribution < DISTRIBUTIONS; distribution++) {
+    double encode = 0;
+    double decode = 0;
+    double copy = 0;
+    size_t size = 0;
+
+    fill(in, distribution);
+    for (int run = 0; run < RUNS; run++) {
+      double start = seconds();
+      size = bitpack_encode(in, VALUES, encoded);
+      double encoded_at = seconds();
+      memcpy(out, in, VALUES * sizeof(int));
+      double copied_at = seconds();
+      memset(out, 0, VALUES * sizeof(int));
+      double cleared_at = seconds();
+      bitpack_decode(encoded, VALUES, out);
+      double decoded_at = seconds();
+
+      if (run == 0 || encoded_at - start < encode) {
+        encode = encoded_at - start;
+      }
+      if (run == 0 || copied_at - encoded_at < copy) {
+        copy = copied_at - encoded_at;
+      }
+      if (run == 0 || decoded_at - cleared_at < decode) {
+        decode = decoded_at - cleared_at;
+      }
+    }
+
+    if (memcmp(in, out, VALUES * sizeof(int)) != 0) {
+      fprintf(stderr, "%s: decoded column differs from the input\n",
+              DISTRIBUTION_NAMES[distribution]);
+      return 1;
+    }
+    printf("%s,%.2f,%.2f,%.2f,%.2f\n", DISTRIBUTION_NAMES[distribution],
+           (double)(VALUES * sizeof(int)) / (double)size, gigabytes / encode,
+           gigabytes / decode, gigabytes / copy);
+  }
+
+  free(in);
+  free(out);
+  free(encoded);
+  return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * bench_signconv.c - Throughput of the signconv.c conversions.
+ *
+ * Each conversion runs over a 256 KB array (it stays in L2) many times and
+ * the best of several runs is reported in GB/s of ints converted, next to
+ * memcpy of the same array and a plain loop over twosComp2SignMag from bits.c.
+ * Values are random with a given number of significant bits, since that sets
+ * the varint lengths; the element-wise kernels do not care. The kernels run at
+ * the ISA level cpu_isa.c picks; BITS_ISA=scalar gives the scalar fallback.
+ *
+ * Output is CSV: one row per conversion and value width.
+ *
+ * Build: gcc -O2 -o bench_signconv bench_signconv.c signconv.c cpu_isa.c
+ *            bits.c
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bitsfn.h"
+#include "signconv.h"
+
+#define VALUES (1 << 16) /* ints per array */
+#define REPEATS 400      /* conversions per timed run */
+#define RUNS 5           /* timed runs, best kept */
+
+static const int WIDTHS[] = {7, 14, 21, 32};
+
+enum conversion {
+  MEMCPY,
+  SIGNMAG_LOOP,
+  TWOS_TO_SIGNMAG,
+  SIGNMAG_TO_TWOS,
+  ZIGZAG_ENCODE,
+  ZIGZAG_DECODE,
+  VARINT_ENCODE,
+  VARINT_DECODE,
+  CONVERSIONS
+};
+
+static const char *const CONVERSION_NAMES[CONVERSIONS] = {
+    "memcpy",
+    "twosComp2SignMag",
+    "twos_to_signmag_n",
+    "signmag_to_twos_n",
+    "zigzag_encode_n",
+    "zigzag_decode_n",
+    "varint_encode_n",
+    "varint_decode_n",
+};
+
+static int in[VALUES];
+static int out[VALUES];
+static uint8_t varints[VARINT_BOUND(VALUES)];
+static size_t varint_bytes;
+
+static double seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static void run(enum conversion conversion) {
+  switch (conversion) {
+  case MEMCPY:
+    memcpy(out, in, sizeof(in));
+    break;
+  case SIGNMAG_LOOP:
+    for (size_t i = 0; i < VALUES; i++) {
+      out[i] = twosComp2SignMag(in[i]);
+    }
+    break;
+  case TWOS_TO_SIGNMAG:
+    twos_to_signmag_n(in, out, VALUES);
+    break;
+  case SIGNMAG_TO_TWOS:
+    signmag_to_twos_n(in, out, VALUES);
+    break;
+  case ZIGZAG_ENCODE:
+    zigzag_encode_n(in, (unsigned *)out, VALUES);
+    break;
+  case ZIGZAG_DECODE:
+    zigzag_decode_n((const unsigned *)in, out, VALUES);
+    break;
+  case VARINT_ENCODE:
+    varint_bytes = varint_encode_n(in, VALUES, varints);
+    break;
+  default:
+    varint_decode_n(varints, varint_bytes, out, VALUES);
+    break;
+  }
+  // Keep the compiler from dropping repeats whose output is never read
+  __asm__ volatile("" ::: "memory");
+}
+
+int main(void) {
+  printf("value_bits,conversion,gbps,varint_bytes_per_value\n");
+  for (size_t w = 0; w < sizeof(WIDTHS) / sizeof(*WIDTHS); w++) {
+    uint64_t state = 1;
+
+    for (size_t i = 0; i < VALUES; i++) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      in[i] = (int)(uint32_t)(state >> 32) >> (32 - WIDTHS[w]);
+    }
+    varint_bytes = varint_encode_n(in, VALUES, varints);
+
+    for (int conversion = 0; conversion < CONVERSIONS; conversion++) {
+      double best = 0;
+
+      for (int r = 0; r < RUNS; r++) {
+        double start = seconds();
+        for (int repeat = 0; repeat < REPEATS; repeat++) {
+          run(conversion);
+        }
+        double elapsed = seconds() - start;
+        if (r == 0 || elapsed < best) {
+          best = elapsed;
+        }
+      }
+      printf("%d,%s,%.2f,%.2f\n", WIDTHS[w], CONVERSION_NAMES[conversion],
+             (double)sizeof(in) * REPEATS / best / 1e9,
+             (double)varint_bytes / VALUES);
+    }
+  }
+  return 0;
+}
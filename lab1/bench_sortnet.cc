@@ -0,0 +1,128 @@
+/*
+ * bench_sortnet.cc - Time sortnet_sort against qsort and std::sort on small
+ *                    arrays.
+ *
+ * Many arrays of n elements, for n from 8 to 64, are sorted one after the
+ * other and the best of several runs is reported in timer ticks per array.
+ * Inputs are random or already sorted: the sorting network does the same work
+ * on both, while qsort and std::sort speed up on sorted input, so the two
+ * rows bracket where the network wins. This is a C++ program only so that it
+ * can call std::sort; sortnet.c itself is C.
+ *
+ * Build: gcc -O2 -c sortnet.c cpu_isa.c
+ *        g++ -O2 -o bench_sortnet bench_sortnet.cc sortnet.o cpu_isa.o
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+extern "C" {
+#include "sortnet.h"
+}
+
+namespace {
+
+constexpr size_t kArrays = 4096; // arrays sorted per timed run
+constexpr size_t kStride = 64;   // room per array, the largest n
+constexpr int kRuns = 7;         // timed runs per row, best kept
+
+const size_t kSizes[] = {8, 12, 16, 24, 32, 48, 64};
+
+// Time stamp in ticks
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+#endif
+}
+
+int compare_ints(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+void sort_qsort(int *a, size_t n) { qsort(a, n, sizeof(int), compare_ints); }
+
+void sort_std(int *a, size_t n) { std::sort(a, a + n); }
+
+void sort_network(int *a, size_t n) { sortnet_sort(a, n); }
+
+struct sorter_t {
+  const char *name;
+  void (*sort)(int *a, size_t n);
+};
+
+const sorter_t kSorters[] = {
+    {"qsort", sort_qsort},
+    {"std_sort", sort_std},
+    {"sortnet", sort_network},
+};
+
+// Best ticks per array over kRuns runs of sort on fresh copies of data
+double time_sort(const sorter_t &sorter, const std::vector<int> &data,
+                 size_t n) {
+  std::vector<int> work(data.size());
+  double best = 0;
+
+  for (int run = 0; run < kRuns; run++) {
+    work = data;
+    uint64_t start = ticks();
+    for (size_t i = 0; i < kArrays; i++) {
+      sorter.sort(&work[i * kStride], n);
+    }
+    double per_array = (double)(ticks() - start) / kArrays;
+    if (run == 0 || per_array < best) {
+      best = per_array;
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+int main() {
+  std::vector<int> random(kArrays * kStride);
+  std::vector<int> sorted(kArrays * kStride);
+  uint64_t state = 1;
+
+  for (size_t i = 0; i < random.size(); i++) {
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    random[i] = (int)((state * 0x2545F4914F6CDD1DULL) >> 32);
+  }
+
+  printf("input,n,qsort,std_sort,sortnet\n");
+  for (int is_sorted = 0; is_sorted <= 1; is_sorted++) {
+    for (size_t n : kSizes) {
+      const std::vector<int> *data = &random;
+      if (is_sorted) {
+        sorted = random;
+        for (size_t i = 0; i < kArrays; i++) {
+          std::sort(&sorted[i * kStride], &sorted[i * kStride] + n);
+        }
+        data = &sorted;
+      }
+
+      printf("%s,%zu", is_sorted ? "sorted" : "random", n);
+      for (const sorter_t &sorter : kSorters) {
+        printf(",%.1f", time_sort(sorter, *data, n));
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
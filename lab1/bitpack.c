@@ -0,0 +1,334 @@
+/*
+ * bitpack.c - Block bit-packing with an SSE2 kernel and a scalar fallback.
+ *
+ * Block layout (the SIMD-BP128 layout): value i of a block goes to lane i % 4,
+ * and each lane packs its 32 values back to back, low bits first, into w
+ * 32-bit words. Word j of lane l is stored at 32-bit index 4 * j + l, so one
+ * 16-byte vector holds word j of all four lanes and a block packs and unpacks
+ * four values at a time with nothing but shifts, ANDs and ORs.
+ *
+ * The width scan ORs together x ^ (x >> 31) over the block, the fitsBits
+ * trick: a value fits in w signed bits iff that has no bits set from w - 1 up.
+ * The block minimum and maximum for frame-of-reference blocks use the
+ * comparison-mask select from conditional.
+ *
+ * Header byte: the width (0 to 32) in the low 6 bits, and FRAME_OF_REFERENCE
+ * set for value - minimum blocks, which are followed by the minimum. Unpacking
+ * computes ((v ^ sign_bit) - sign_bit) + reference for every value, which
+ * sign-extends signed blocks (reference 0) and adds the minimum back for
+ * frame-of-reference blocks (sign_bit 0), so both decode without a branch.
+ */
+#include "bitpack.h"
+
+#include <string.h>
+
+#include "cpu_isa.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITPACK_X86
+#endif
+
+#define LANES 4                            /* 32-bit lanes in the layout */
+#define LANE_VALUES (BITPACK_BLOCK / LANES) /* values packed per lane */
+#define FRAME_OF_REFERENCE 0x80             /* header flag */
+#define WIDTH_MASK 0x3F                     /* header width bits */
+#define MAX_WIDTH 32                        /* widest valid header width */
+
+typedef struct {
+  int signed_width; /* smallest width fitsBits accepts for every value */
+  int offset_width; /* unsigned width of maximum - minimum */
+  int minimum;
+} block_stats_t;
+
+typedef void (*scan_kernel)(const int *in, block_stats_t *stats);
+typedef void (*pack_kernel)(const int *in, unsigned reference, int width,
+                            uint8_t *out);
+typedef void (*unpack_kernel)(const uint8_t *in, unsigned reference,
+                              unsigned sign_bit, int width, int *out);
+
+struct kernels {
+  scan_kernel scan;
+  pack_kernel pack;
+  unpack_kernel unpack;
+};
+
+// Number of significant bits in x
+static inline int bit_length(unsigned x) {
+  return x ? 32 - __builtin_clz(x) : 0;
+}
+
+static inline unsigned low_mask(int width) {
+  return (width == 32) ? ~0U : (1U << width) - 1;
+}
+
+static void set_stats(block_stats_t *stats, unsigned magnitudes, unsigned any,
+                      int minimum, int maximum) {
+  // All magnitudes 0 means every value is 0 or -1, and -1 still takes a bit
+  stats->signed_width = magnitudes ? bit_length(magnitudes) + 1 : (any != 0);
+  stats->offset_width = bit_length((unsigned)maximum - (unsigned)minimum);
+  stats->minimum = minimum;
+}
+
+static void scan_scalar(const int *in, block_stats_t *stats) {
+  unsigned magnitudes = 0;
+  unsigned any = 0;
+  int minimum = in[0];
+  int maximum = in[0];
+  for (int i = 0; i < BITPACK_BLOCK; i++) {
+    magnitudes |= (unsigned)(in[i] ^ (in[i] >> 31));
+    any |= (unsigned)in[i];
+    minimum = (in[i] < minimum) ? in[i] : minimum;
+    maximum = (in[i] > maximum) ? in[i] : maximum;
+  }
+  set_stats(stats, magnitudes, any, minimum, maximum);
+}
+
+static void pack_scalar(const int *in, unsigned reference, int width,
+                        uint8_t *out) {
+  unsigned words[BITPACK_BLOCK];
+  const unsigned mask = low_mask(width);
+
+  memset(words, 0, (size_t)width * LANES * sizeof(unsigned));
+  for (int i = 0; i < BITPACK_BLOCK; i++) {
+    unsigned value = ((unsigned)in[i] - reference) & mask;
+    int bit = (i / LANES) * width;
+    unsigned *word = &words[(bit / 32) * LANES + i % LANES];
+    word[0] |= value << (bit % 32);
+    if (bit % 32 + width > 32) {
+      word[LANES] |= value >> (32 - bit % 32);
+    }
+  }
+  memcpy(out, words, (size_t)width * LANES * sizeof(unsigned));
+}
+
+static void unpack_scalar(const uint8_t *in, unsigned reference,
+                          unsigned sign_bit, int width, int *out) {
+  unsigned words[BITPACK_BLOCK + LANES] = {0};
+  const unsigned mask = low_mask(width);
+
+  memcpy(words, in, (size_t)width * LANES * sizeof(unsigned));
+  for (int i = 0; i < BITPACK_BLOCK; i++) {
+    int bit = (i / LANES) * width;
+    const unsigned *word = &words[(bit / 32) * LANES + i % LANES];
+    unsigned value = word[0] >> (bit % 32);
+    if (bit % 32 + width > 32) {
+      value |= word[LANES] << (32 - bit % 32);
+    }
+    value &= mask;
+    out[i] = (int)(((value ^ sign_bit) - sign_bit) + reference);
+  }
+}
+
+#ifdef BITPACK_X86
+
+typedef unsigned vec_t __attribute__((vector_size(16), aligned(1), may_alias));
+typedef int ivec_t __attribute__((vector_size(16), aligned(1), may_alias));
+
+typedef void (*pack_width_fn)(const int *in, unsigned reference, uint8_t *out);
+typedef void (*unpack_width_fn)(const uint8_t *in, unsigned reference,
+                                unsigned sign_bit, int *out);
+
+__attribute__((target("sse2"))) static void scan_sse2(const int *in,
+                                                      block_stats_t *stats) {
+  ivec_t magnitudes = {0};
+  ivec_t any = {0};
+  ivec_t minimum = *(const ivec_t *)in;
+  ivec_t maximum = minimum;
+  for (int i = 0; i < BITPACK_BLOCK; i += LANES) {
+    ivec_t x = *(const ivec_t *)(in + i);
+    ivec_t is_less = x < minimum;
+    ivec_t is_greater = x > maximum;
+    magnitudes |= x ^ (x >> 31);
+    any |= x;
+    minimum = (x & is_less) | (minimum & ~is_less);
+    maximum = (x & is_greater) | (maximum & ~is_greater);
+  }
+  for (int i = 0; i < LANES; i++) {
+    magnitudes[0] |= magnitudes[i];
+    any[0] |= any[i];
+    minimum[0] = (minimum[i] < minimum[0]) ? minimum[i] : minimum[0];
+    maximum[0] = (maximum[i] > maximum[0]) ? maximum[i] : maximum[0];
+  }
+  set_stats(stats, (unsigned)magnitudes[0], (unsigned)any[0], minimum[0],
+            maximum[0]);
+}
+
+/*
+ * pack_fixed, unpack_fixed - one block at a constant width. They are always
+ *     inlined into a function per width, where the loop unrolls completely and
+ *     every shift and word boundary becomes a constant.
+ */
+__attribute__((target("sse2"), always_inline)) static inline void
+pack_fixed(const int *in, unsigned reference, const int width, uint8_t *out) {
+  const unsigned mask = low_mask(width);
+  vec_t word = {0};
+  int filled = 0;
+
+#pragma GCC unroll 32
+  for (int j = 0; j < LANE_VALUES; j++) {
+    vec_t value = (*(const vec_t *)(in + j * LANES) - reference) & mask;
+    word |= value << filled;
+    filled += width;
+    if (filled >= 32) {
+      *(vec_t *)out = word;
+      out += sizeof(vec_t);
+      filled -= 32;
+      word = filled ? value >> (width - filled) : (vec_t){0};
+    }
+  }
+}
+
+__attribute__((target("sse2"), always_inline)) static inline void
+unpack_fixed(const uint8_t *in, unsigned reference, unsigned sign_bit,
+             const int width, int *out) {
+  const unsigned mask = low_mask(width);
+  vec_t word = *(const vec_t *)in;
+  int used = 0;
+
+#pragma GCC unroll 32
+  for (int j = 0; j < LANE_VALUES; j++) {
+    vec_t value;
+    if (used + width <= 32) {
+      value = word >> used;
+      used += width;
+      if (used == 32 && j + 1 < LANE_VALUES) {
+        in += sizeof(vec_t);
+        word = *(const vec_t *)in;
+        used = 0;
+      }
+    } else {
+      in += sizeof(vec_t);
+      vec_t next = *(const vec_t *)in;
+      value = (word >> used) | (next << (32 - used));
+      word = next;
+      used += width - 32;
+    }
+    value &= mask;
+    *(vec_t *)(out + j * LANES) = ((value ^ sign_bit) - sign_bit) + reference;
+  }
+}
+
+#define FOR_EACH_WIDTH(X)                                                      \
+  X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14)   \
+  X(15) X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26)      \
+  X(27) X(28) X(29) X(30) X(31) X(32)
+
+#define DEFINE_WIDTH(width)                                                    \
+  __attribute__((target("sse2"))) static void pack_##width(                    \
+      const int *in, unsigned reference, uint8_t *out) {                       \
+    pack_fixed(in, reference, width, out);                                     \
+  }                                                                            \
+                                                                               \
+  __attribute__((target("sse2"))) static void unpack_##width(                  \
+      const uint8_t *in, unsigned reference, unsigned sign_bit, int *out) {    \
+    unpack_fixed(in, reference, sign_bit, width, out);                         \
+  }
+
+#define PACK_ENTRY(width) pack_##width,
+#define UNPACK_ENTRY(width) unpack_##width,
+
+FOR_EACH_WIDTH(DEFINE_WIDTH)
+
+// Indexed by width - 1; width 0 never reaches the kernels' tables
+static const pack_width_fn PACK_WIDTH[32] = {FOR_EACH_WIDTH(PACK_ENTRY)};
+static const unpack_width_fn UNPACK_WIDTH[32] = {FOR_EACH_WIDTH(UNPACK_ENTRY)};
+
+static void pack_sse2(const int *in, unsigned reference, int width,
+                      uint8_t *out) {
+  PACK_WIDTH[width - 1](in, reference, out);
+}
+
+static void unpack_sse2(const uint8_t *in, unsigned reference,
+                        unsigned sign_bit, int width, int *out) {
+  UNPACK_WIDTH[width - 1](in, reference, sign_bit, out);
+}
+
+#endif
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static struct kernels active = {scan_scalar, pack_scalar, unpack_scalar};
+
+__attribute__((constructor)) static void select_kernels(void) {
+#ifdef BITPACK_X86
+  // The layout is fixed at four lanes, so wider vectors would not help
+  if (cpu_isa_level() >= ISA_SSE2) {
+    active = (struct kernels){scan_sse2, pack_sse2, unpack_sse2};
+  }
+#endif
+}
+
+size_t bitpack_encode(const int *in, size_t n, uint8_t *out) {
+  uint8_t *start = out;
+  int padded[BITPACK_BLOCK];
+
+  for (size_t i = 0; i < n; i += BITPACK_BLOCK) {
+    const int *block = in + i;
+    if (n - i < BITPACK_BLOCK) {
+      // Pad with a value already in the block, so the widths do not change
+      memcpy(padded, block, (n - i) * sizeof(int));
+      for (size_t j = n - i; j < BITPACK_BLOCK; j++) {
+        padded[j] = block[0];
+      }
+      block = padded;
+    }
+
+    block_stats_t stats;
+    active.scan(block, &stats);
+
+    int width = stats.signed_width;
+    unsigned reference = 0;
+    if (stats.offset_width < stats.signed_width) {
+      width = stats.offset_width;
+      reference = (unsigned)stats.minimum;
+      *out++ = (uint8_t)(FRAME_OF_REFERENCE | width);
+      memcpy(out, &stats.minimum, sizeof(int));
+      out += sizeof(int);
+    } else {
+      *out++ = (uint8_t)width;
+    }
+
+    if (width > 0) {
+      active.pack(block, reference, width, out);
+      out += (size_t)width * LANES * sizeof(unsigned);
+    }
+  }
+  return (size_t)(out - start);
+}
+
+size_t bitpack_decode(const uint8_t *in, size_t n, int *out) {
+  const uint8_t *start = in;
+  int padded[BITPACK_BLOCK];
+
+  for (size_t i = 0; i < n; i += BITPACK_BLOCK) {
+    int *block = (n - i < BITPACK_BLOCK) ? padded : out + i;
+    int header = *in++;
+    int width = header & WIDTH_MASK;
+    unsigned reference = 0;
+    unsigned sign_bit = 0;
+
+    // The kernels index their tables by width and shift by it
+    if (width > MAX_WIDTH) {
+      return 0;
+    }
+    if (header & FRAME_OF_REFERENCE) {
+      memcpy(&reference, in, sizeof(unsigned));
+      in += sizeof(unsigned);
+    } else if (width > 0) {
+      sign_bit = 1U << (width - 1);
+    }
+
+    if (width > 0) {
+      active.unpack(in, reference, sign_bit, width, block);
+      in += (size_t)width * LANES * sizeof(unsigned);
+    } else {
+      for (int j = 0; j < BITPACK_BLOCK; j++) {
+        block[j] = (int)reference;
+      }
+    }
+
+    if (block == padded) {
+      memcpy(out + i, padded, (n - i) * sizeof(int));
+    }
+  }
+  return (size_t)(in - start);
+}
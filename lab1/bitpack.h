@@ -0,0 +1,32 @@
+/*
+ * bitpack.h - Block bit-packing codec for int columns whose values mostly fit
+ *             in far fewer than 32 bits.
+ *
+ * Values are coded in blocks of BITPACK_BLOCK. Each block is stored either at
+ * the smallest signed width that fits every value (the fitsBits question,
+ * asked of the whole block), or frame-of-reference style as value - minimum at
+ * the smallest unsigned width, whichever is smaller. A block takes 1 header
+ * byte, 4 more for the minimum in frame-of-reference blocks, and 16 bytes per
+ * bit of width. The minimum is stored in host byte order.
+ */
+#ifndef BITPACK_H
+#define BITPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BITPACK_BLOCK 128
+
+// Largest encoding of n values
+#define BITPACK_BOUND(n)                                                       \
+  ((((n) + BITPACK_BLOCK - 1) / BITPACK_BLOCK) * (5 + BITPACK_BLOCK * 4))
+
+// Encodes n values into out, which must hold BITPACK_BOUND(n) bytes. Returns
+// the number of bytes written.
+size_t bitpack_encode(const int *in, size_t n, uint8_t *out);
+
+// Decodes n values from in into out. Returns the number of bytes read, or 0
+// if a block header has a width above 32, which only a corrupt input can have.
+size_t bitpack_decode(const uint8_t *in, size_t n, int *out);
+
+#endif
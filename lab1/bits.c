@@ -166,18 +166,15 @@ NOTES:
  *   Rating: 1
  */
 int isTmax(int x) {
-  // Attempts to overflow x, which will only occur if x is Tmax. Note that Tmax
-  // + 1 = Tmin.
-  int try_overflow = x + 1;
-  // Checks that x actually did overflow. Note that the expression (a ^ b)
-  // yields -1 (all 1s in the binary representation) if a == Tmax and b ==
-  // Tmin. ~(-1) yields 0. !0 yields 1.
+  // x + x + 2 == 2 * (x + 1) is 0 only for Tmax (Tmax + 1 = Tmin, and Tmin
+  // doubled overflows to 0) and for -1. !~x is 1 only for -1, so XOR-ing it in
+  // leaves zero exactly when x is Tmax.
   //
-  // There is an edge case where -1 + 1 == 0 and (-1 ^ 0) yields -1. If x is -1,
-  // then `!(x + 1)` will yield 1; if x is Tmax, then `!(x + 1)` yields 0. This
-  // allows x == -1 to be distinguished from x == Tmax.
-  int is_t_max = !(~((x + !try_overflow) ^ try_overflow));
-  return is_t_max;
+  // Same op count as checking for overflow of x + 1, but the critical path is
+  // 4 operators instead of 6. Found with superopt.c.
+  int twice_x_plus_1 = x + x + 2;
+  int is_neg_one = !~x;
+  return !(is_neg_one ^ twice_x_plus_1);
 }
 /*
  * evenBits - return word with all even-numbered bits set to 1
@@ -259,51 +256,17 @@ int conditional(int x, int y, int z) {
  *   Rating: 3
  */
 int isGreater(int x, int y) {
-  const int max_shift = 31;
-  const int t_min = 1 << max_shift;
-  const int t_max = ~t_min;
-  // Capture bits that differ between x and y.
-  int diff = x ^ y;
-  // "Smear" the leftmost 1 bit. E.g. 0b0101 becomes 0b0111.
-  int smeared_diff = diff | diff >> 1;
-  // Data lab checker does not allow definitions after non-definition
-  // statements, so these variables must be defined in advance.
-  int only_left_diff = 0;
-  int x_flip_sign = 0;
-  int y_flip_all_except_sign = 0;
-  int greater_bits_x = 0;
-  int pos_x_neg_y = 0;
-  int x_has_greater_diff = 0;
-  smeared_diff = smeared_diff | smeared_diff >> 2;
-  smeared_diff = smeared_diff | smeared_diff >> 4;
-  smeared_diff = smeared_diff | smeared_diff >> 8;
-  smeared_diff = smeared_diff | smeared_diff >> 16;
-  // Only keep the leftmost 1 bit
-  only_left_diff = smeared_diff ^ (smeared_diff >> 1);
-  x_flip_sign = x ^ t_min;
-  y_flip_all_except_sign = y ^ t_max;
-  // Does two useful things:
-  //
-  // 1. If x is positive and y is negative, the MSB of this variable is set
-  // to 1. If x is negative, or if y is positive, the MSB of this variable is
-  // set to 0.
-  //
-  // 2. Captures the bits in x greater than the corresponding bits in y. For
-  // example, if the LSB in x is 1 while in y it's 0, the LSB of this variable
-  // will be set to 1.
-  greater_bits_x = x_flip_sign & y_flip_all_except_sign;
-  // x >= 0 and y < 0 guarantees x > y.
-  pos_x_neg_y = t_min & greater_bits_x;
-  // If the bit with the leftmost bit difference is greater in x than y, this
-  // variable is set to a nonzero value. If the bit in y is greater, it's set to
-  // zero.
+  // x > y exactly when x - y - 1 >= 0, and x + ~y computes x - y - 1.
   //
-  // Note that if x is negative and y is positive, the leftmost bit difference
-  // will always be the MSB. But since this implies the MSB of x < MSB of y,
-  // then this variable will always be set to zero, which makes sense given that
-  // x < 0 and y >= 0 guarantees x < y.
-  x_has_greater_diff = only_left_diff & greater_bits_x;
-  return !!(pos_x_neg_y | x_has_greater_diff);
+  // If x and y have the same sign, x and ~y have different signs, so the
+  // addition cannot overflow and its sign bit is the answer. If the signs
+  // differ, x > y exactly when x >= 0, so the sign bit of x is the answer
+  // instead: OR-ing y with all ones there makes ~y 0 and the sum just x.
+  // 7 ops, found by superopt.c.
+  const int max_shift = 31;
+  int signs_differ = (x ^ y) >> max_shift; // all ones if they differ
+  int sign_source = x + ~(y | signs_differ);
+  return !(sign_source >> max_shift);
 }
 /*
  * multFiveEighths - multiplies by 5/8 rounding toward 0.
@@ -319,13 +282,16 @@ int isGreater(int x, int y) {
 int multFiveEighths(int x) {
   // Multiples x by 5 using repeated addition, then divides by 8 using a right
   // shift of 3. Since the result is rounded toward 0 instead of rounded down,
-  // one is added if x is negative and dividing by 8 leaves a remainder.
+  // one is added if x * 5 is negative and dividing by 8 leaves a remainder.
+  //
+  // The sign must be taken from x * 5 rather than x, since the multiplication
+  // can overflow and flip the sign (e.g. x = 429496730).
 
   const int divide_8 = 3;
   const int max_shift = 31;
   const int remainder_mask = 7;
   int x_mult_5 = x + x + x + x + x;
-  int is_neg = x >> max_shift;
+  int is_neg = x_mult_5 >> max_shift;
   int has_remainder = x_mult_5 & remainder_mask;
   return (x_mult_5 >> divide_8) + !!(is_neg & has_remainder);
 }
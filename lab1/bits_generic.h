@@ -0,0 +1,158 @@
+/*
+ * bits_generic.h - The bits.c tricks for every integer width, signed and
+ *                  unsigned.
+ *
+ * bits.c is fixed to 32-bit int. This header generates the same branch-free
+ * primitives for char, short, int, long, long long and __int128 (where the
+ * compiler has it), plus their unsigned versions:
+ *
+ *   is_greater(x, y)         x > y
+ *   fits_bits(x, n)          x fits in an n-bit integer of the same signedness,
+ *                            1 <= n <= width
+ *   select_if(c, a, b)       c ? a : b, without a branch
+ *   mul_frac(x, num, shift)  x * num / 2^shift, 0 <= shift < width,
+ *                            rounding toward zero and wrapping like the C
+ *                            expression (so mul_frac(x, 5, 3) is
+ *                            multFiveEighths)
+ *   is_pow2(x)               x is a power of 2 (never true for x <= 0)
+ *
+ * Each macro picks the version for the type of its first value argument
+ * through _Generic; the typed functions (is_greater_int, fits_bits_ullong,
+ * mul_frac_schar, ...) can also be called directly. Predicates return int 0 or
+ * 1. Plain char is not dispatched, since its signedness varies; use signed
+ * char or unsigned char.
+ *
+ * Everything is static inline and the widths, masks and sign bits are integer
+ * constant expressions (BITS_WIDTH, BITS_SIGN_BIT, BITS_EVEN, ...), so calls
+ * with constant arguments fold away completely, which covers the compile-time
+ * use the mul_frac num and shift are meant for. Arithmetic is done in the
+ * unsigned type, so wrapping is defined; like bits.c, the signed versions rely
+ * on >> being arithmetic.
+ */
+#ifndef BITS_GENERIC_H
+#define BITS_GENERIC_H
+
+#include <limits.h>
+
+// Number of bits in T
+#define BITS_WIDTH(T) ((int)(sizeof(T) * CHAR_BIT))
+
+// Unsigned type U with only the top (sign) bit set
+#define BITS_SIGN_BIT(U) ((U)((U)1 << (BITS_WIDTH(U) - 1)))
+
+// Unsigned type U with the low n bits set, 0 <= n < width
+#define BITS_LOW_MASK(U, n) ((U)(((U)1 << (n)) - 1U))
+
+// Unsigned type U with every even-numbered bit set (evenBits for any width)
+#define BITS_EVEN(U) ((U)((U)-1 / 3U))
+
+/*
+ * DEFINE_BITS_PRIMITIVES(ssfx, usfx, T, U) - All primitives for the signed type
+ *     T (functions suffixed ssfx) and its unsigned counterpart U (usfx).
+ *
+ * Operands are converted to U before any arithmetic, and multiplications start
+ * from 1U so types narrower than int are promoted to unsigned int rather than
+ * int and cannot overflow.
+ */
+#define DEFINE_BITS_PRIMITIVES(ssfx, usfx, T, U)                               \
+  /* Signed x > y on the raw bits: the sign of x - y - 1, or of x itself when  \
+   * the signs differ and the subtraction could overflow */                    \
+  static inline int is_greater_bits_##usfx(U x, U y) {                         \
+    const int max_shift = BITS_WIDTH(U) - 1;                                   \
+    U x_minus_y_minus_1 = (U)(1U * x + (U)~y);                                 \
+    U signs_differ = (U)(x ^ y);                                               \
+    U sign_source = (U)(x_minus_y_minus_1 ^                                    \
+                        (signs_differ & (x_minus_y_minus_1 ^ x)));             \
+    return !(sign_source >> max_shift);                                        \
+  }                                                                            \
+                                                                               \
+  static inline int is_greater_##ssfx(T x, T y) {                              \
+    return is_greater_bits_##usfx((U)x, (U)y);                                 \
+  }                                                                            \
+                                                                               \
+  /* Flipping the sign bits maps unsigned order onto signed order */           \
+  static inline int is_greater_##usfx(U x, U y) {                              \
+    return is_greater_bits_##usfx((U)(x ^ BITS_SIGN_BIT(U)),                   \
+                                  (U)(y ^ BITS_SIGN_BIT(U)));                  \
+  }                                                                            \
+                                                                               \
+  /* x fits iff x (or ~x when negative) has no set bits from n - 1 up */       \
+  static inline int fits_bits_##ssfx(T x, int n) {                             \
+    const int max_shift = BITS_WIDTH(T) - 1;                                   \
+    U magnitude = (U)(x ^ (x >> max_shift));                                   \
+    return !(magnitude >> (n - 1));                                            \
+  }                                                                            \
+                                                                               \
+  /* Two shifts, since a single shift by n == width is undefined */            \
+  static inline int fits_bits_##usfx(U x, int n) {                             \
+    return !((x >> (n - 1)) >> 1);                                             \
+  }                                                                            \
+                                                                               \
+  static inline U select_if_##usfx(int cond, U a, U b) {                       \
+    U take_a = (U)(0U - (U)!!cond);                                            \
+    return (U)((a & take_a) | (b & (U)~take_a));                               \
+  }                                                                            \
+                                                                               \
+  static inline T select_if_##ssfx(int cond, T a, T b) {                       \
+    return (T)select_if_##usfx(cond, (U)a, (U)b);                              \
+  }                                                                            \
+                                                                               \
+  /* Negative products get 2^shift - 1 added so the shift rounds toward zero,  \
+   * with the sign taken from the wrapped product, as in multFiveEighths.      \
+   * shift must be below the width, for BITS_LOW_MASK and the shift itself */  \
+  static inline T mul_frac_##ssfx(T x, T num, int shift) {                     \
+    const int max_shift = BITS_WIDTH(T) - 1;                                   \
+    U product = (U)(1U * (U)x * (U)num);                                       \
+    U is_neg_mask = (U)(0U - (U)(product >> max_shift));                       \
+    U bias = (U)(is_neg_mask & BITS_LOW_MASK(U, shift));                       \
+    return (T)((T)(U)(1U * product + bias) >> shift);                          \
+  }                                                                            \
+                                                                               \
+  static inline U mul_frac_##usfx(U x, U num, int shift) {                     \
+    return (U)((U)(1U * x * num) >> shift);                                    \
+  }                                                                            \
+                                                                               \
+  static inline int is_pow2_##usfx(U x) {                                      \
+    return !!x & !(x & (U)(x - 1U));                                           \
+  }                                                                            \
+                                                                               \
+  static inline int is_pow2_##ssfx(T x) {                                      \
+    const int max_shift = BITS_WIDTH(T) - 1;                                   \
+    return is_pow2_##usfx((U)x) & !((U)x >> max_shift);                        \
+  }
+
+DEFINE_BITS_PRIMITIVES(schar, uchar, signed char, unsigned char)
+DEFINE_BITS_PRIMITIVES(short, ushort, short, unsigned short)
+DEFINE_BITS_PRIMITIVES(int, uint, int, unsigned int)
+DEFINE_BITS_PRIMITIVES(long, ulong, long, unsigned long)
+DEFINE_BITS_PRIMITIVES(llong, ullong, long long, unsigned long long)
+#ifdef __SIZEOF_INT128__
+DEFINE_BITS_PRIMITIVES(i128, u128, __int128, unsigned __int128)
+#define BITS_GENERIC_128(fn)                                                   \
+  , __int128 : fn##_i128, unsigned __int128 : fn##_u128
+#else
+#define BITS_GENERIC_128(fn)
+#endif
+
+// The version of fn for the type of x
+#define BITS_GENERIC(fn, x)                                                    \
+  _Generic((x),                                                                \
+      signed char: fn##_schar,                                                 \
+      unsigned char: fn##_uchar,                                               \
+      short: fn##_short,                                                       \
+      unsigned short: fn##_ushort,                                             \
+      int: fn##_int,                                                           \
+      unsigned int: fn##_uint,                                                 \
+      long: fn##_long,                                                         \
+      unsigned long: fn##_ulong,                                               \
+      long long: fn##_llong,                                                   \
+      unsigned long long: fn##_ullong BITS_GENERIC_128(fn))
+
+#define is_greater(x, y) BITS_GENERIC(is_greater, x)(x, y)
+#define fits_bits(x, n) BITS_GENERIC(fits_bits, x)(x, n)
+// Dispatches on a; b is converted to the type of a
+#define select_if(c, a, b) BITS_GENERIC(select_if, a)(!!(c), a, b)
+#define mul_frac(x, num, shift) BITS_GENERIC(mul_frac, x)(x, num, shift)
+#define is_pow2(x) BITS_GENERIC(is_pow2, x)(x)
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * bits_vec.c - Array versions of the bits.c predicates, with SSE2, AVX2 and
+ *              AVX-512 kernels chosen at startup.
+ *
+ * The kernels are written once with GCC vector extensions and instantiated per
+ * instruction set through target attributes, so this file builds without any
+ * -m flags. A vector comparison yields -1 or 0 per lane, which is the same
+ * all-ones/all-zeros mask trick conditional uses in bits.c; ANDing it with the
+ * requested lane value gives either the 0/1 or the 0/-1 result.
+ */
+#include "bits_vec.h"
+#include "bitsfn.h"
+#include "cpu_isa.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITS_VEC_X86
+#endif
+
+typedef void (*binary_kernel)(const int *x, const int *y, int *out, size_t n,
+                              int value);
+typedef void (*width_kernel)(const int *x, int bits, int *out, size_t n,
+                             int value);
+typedef void (*unary_kernel)(const int *x, int *out, size_t n, int value);
+
+struct kernels {
+  binary_kernel is_equal;
+  width_kernel fits_bits;
+  binary_kernel is_greater;
+  unary_kernel logical_neg;
+  unary_kernel is_power2;
+};
+
+/*
+ * Scalar kernels, also used for the tail of every vector kernel. -f & value
+ * turns a 0/1 result into 0/1 (value 1) or 0/-1 (value -1).
+ */
+static void is_equal_scalar(const int *x, const int *y, int *out, size_t n,
+                            int value) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = -isEqual(x[i], y[i]) & value;
+  }
+}
+
+static void fits_bits_scalar(const int *x, int bits, int *out, size_t n,
+                             int value) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = -fitsBits(x[i], bits) & value;
+  }
+}
+
+static void is_greater_scalar(const int *x, const int *y, int *out, size_t n,
+                              int value) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = -isGreater(x[i], y[i]) & value;
+  }
+}
+
+static void logical_neg_scalar(const int *x, int *out, size_t n, int value) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = -logicalNeg(x[i]) & value;
+  }
+}
+
+static void is_power2_scalar(const int *x, int *out, size_t n, int value) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = -isPower2(x[i]) & value;
+  }
+}
+
+#ifdef BITS_VEC_X86
+
+/*
+ * DEFINE_KERNELS(isa, isa_target, bytes) - instantiate the five vector
+ *     kernels for one instruction set with bytes-wide vectors. The vector
+ *     type is only 4-byte aligned, so loads and stores may be unaligned.
+ *
+ * fitsBits keeps the bits.c idea: x fits in bits signed bits iff shifting out
+ * the low bits - 1 leaves only copies of the sign bit. isPower2 is x > 0 with
+ * no bit shared between x and x - 1.
+ */
+#define DEFINE_KERNELS(isa, isa_target, bytes)                                 \
+  typedef int vec_##isa __attribute__((vector_size(bytes), aligned(4)));       \
+  typedef unsigned uvec_##isa __attribute__((vector_size(bytes)));             \
+                                                                               \
+  __attribute__((target(isa_target))) static void is_equal_##isa(              \
+      const int *x, const int *y, int *out, size_t n, int value) {             \
+    const size_t lanes = (bytes) / sizeof(int);                                \
+    size_t i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                       \
+      vec_##isa vx = *(const vec_##isa *)(x + i);                              \
+      vec_##isa vy = *(const vec_##isa *)(y + i);                              \
+      *(vec_##isa *)(out + i) = (vx == vy) & value;                            \
+    }                                                                          \
+    is_equal_scalar(x + i, y + i, out + i, n - i, value);                      \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa_target))) static void fits_bits_##isa(             \
+      const int *x, int bits, int *out, size_t n, int value) {                 \
+    const size_t lanes = (bytes) / sizeof(int);                                \
+    const int max_shift = 31;                                                  \
+    size_t i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                       \
+      vec_##isa vx = *(const vec_##isa *)(x + i);                              \
+      *(vec_##isa *)(out + i) =                                                \
+          ((vx >> (bits - 1)) == (vx >> max_shift)) & value;                   \
+    }                                                                          \
+    fits_bits_scalar(x + i, bits, out + i, n - i, value);                      \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa_target))) static void is_greater_##isa(            \
+      const int *x, const int *y, int *out, size_t n, int value) {             \
+    const size_t lanes = (bytes) / sizeof(int);                                \
+    size_t i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                       \
+      vec_##isa vx = *(const vec_##isa *)(x + i);                              \
+      vec_##isa vy = *(const vec_##isa *)(y + i);                              \
+      *(vec_##isa *)(out + i) = (vx > vy) & value;                             \
+    }                                                                          \
+    is_greater_scalar(x + i, y + i, out + i, n - i, value);                    \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa_target))) static void logical_neg_##isa(           \
+      const int *x, int *out, size_t n, int value) {                           \
+    const size_t lanes = (bytes) / sizeof(int);                                \
+    size_t i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                       \
+      vec_##isa vx = *(const vec_##isa *)(x + i);                              \
+      *(vec_##isa *)(out + i) = (vx == 0) & value;                             \
+    }                                                                          \
+    logical_neg_scalar(x + i, out + i, n - i, value);                          \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa_target))) static void is_power2_##isa(             \
+      const int *x, int *out, size_t n, int value) {                           \
+    const size_t lanes = (bytes) / sizeof(int);                                \
+    size_t i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                       \
+      vec_##isa vx = *(const vec_##isa *)(x + i);                              \
+      /* x - 1 in unsigned lanes, where Tmin - 1 wraps without overflow */     \
+      vec_##isa vx_minus_1 = (vec_##isa)((uvec_##isa)vx - 1);                  \
+      *(vec_##isa *)(out + i) = (vx > 0) & ((vx & vx_minus_1) == 0) & value;   \
+    }                                                                          \
+    is_power2_scalar(x + i, out + i, n - i, value);                            \
+  }
+
+DEFINE_KERNELS(sse2, "sse2", 16)
+DEFINE_KERNELS(avx2, "avx2", 32)
+DEFINE_KERNELS(avx512, "avx512f,avx512bw", 64)
+
+#endif
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static struct kernels active = {is_equal_scalar, fits_bits_scalar,
+                                is_greater_scalar, logical_neg_scalar,
+                                is_power2_scalar};
+
+__attribute__((constructor)) static void select_kernels(void) {
+  switch (cpu_isa_level()) {
+#ifdef BITS_VEC_X86
+  case ISA_AVX512:
+    active = (struct kernels){is_equal_avx512, fits_bits_avx512,
+                              is_greater_avx512, logical_neg_avx512,
+                              is_power2_avx512};
+    break;
+  case ISA_AVX2:
+    active = (struct kernels){is_equal_avx2, fits_bits_avx2, is_greater_avx2,
+                              logical_neg_avx2, is_power2_avx2};
+    break;
+  case ISA_SSE2:
+    active = (struct kernels){is_equal_sse2, fits_bits_sse2, is_greater_sse2,
+                              logical_neg_sse2, is_power2_sse2};
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+void isEqual_n(const int *x, const int *y, int *out, size_t n) {
+  active.is_equal(x, y, out, n, 1);
+}
+
+void isEqual_mask_n(const int *x, const int *y, int *out, size_t n) {
+  active.is_equal(x, y, out, n, -1);
+}
+
+void fitsBits_n(const int *x, int bits, int *out, size_t n) {
+  active.fits_bits(x, bits, out, n, 1);
+}
+
+void fitsBits_mask_n(const int *x, int bits, int *out, size_t n) {
+  active.fits_bits(x, bits, out, n, -1);
+}
+
+void isGreater_n(const int *x, const int *y, int *out, size_t n) {
+  active.is_greater(x, y, out, n, 1);
+}
+
+void isGreater_mask_n(const int *x, const int *y, int *out, size_t n) {
+  active.is_greater(x, y, out, n, -1);
+}
+
+void logicalNeg_n(const int *x, int *out, size_t n) {
+  active.logical_neg(x, out, n, 1);
+}
+
+void logicalNeg_mask_n(const int *x, int *out, size_t n) {
+  active.logical_neg(x, out, n, -1);
+}
+
+void isPower2_n(const int *x, int *out, size_t n) {
+  active.is_power2(x, out, n, 1);
+}
+
+void isPower2_mask_n(const int *x, int *out, size_t n) {
+  active.is_power2(x, out, n, -1);
+}
@@ -0,0 +1,33 @@
+/*
+ * bits_vec.h - Array versions of the bits.c predicates.
+ *
+ * Each *_n function applies its predicate to n elements and writes 1 or 0 per
+ * element, exactly like the scalar function in bits.c. The *_mask_n variants
+ * write -1 (all bits set) or 0 instead, so the result can be ANDed straight
+ * into the data being filtered. out may alias an input array.
+ *
+ * The SSE2, AVX2 or AVX-512 kernel is picked once at startup (see cpu_isa.h);
+ * leftover elements and CPUs without those extensions use bits.c itself.
+ */
+#ifndef BITS_VEC_H
+#define BITS_VEC_H
+
+#include <stddef.h>
+
+void isEqual_n(const int *x, const int *y, int *out, size_t n);
+void isEqual_mask_n(const int *x, const int *y, int *out, size_t n);
+
+// Every element is checked against the same width, 1 <= bits <= 32
+void fitsBits_n(const int *x, int bits, int *out, size_t n);
+void fitsBits_mask_n(const int *x, int bits, int *out, size_t n);
+
+void isGreater_n(const int *x, const int *y, int *out, size_t n);
+void isGreater_mask_n(const int *x, const int *y, int *out, size_t n);
+
+void logicalNeg_n(const int *x, int *out, size_t n);
+void logicalNeg_mask_n(const int *x, int *out, size_t n);
+
+void isPower2_n(const int *x, int *out, size_t n);
+void isPower2_mask_n(const int *x, int *out, size_t n);
+
+#endif
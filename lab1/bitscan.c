@@ -0,0 +1,203 @@
+/*
+ * bitscan.c - Batch bit counting and scanning, with SSE2, AVX2 and AVX-512
+ *             kernels chosen at startup.
+ *
+ * The vector kernels are the portable functions from bitscan.h instantiated
+ * for GCC vectors, so each lane runs the same SWAR popcount and smear ladders.
+ * Base AVX-512 adds no bit-counting instructions, but AVX512CD has a per-lane
+ * leading zero count and AVX512_VPOPCNTDQ a per-lane popcount; where the CPU
+ * has them the AVX-512 kernels use those instead of the ladders, unless
+ * BITS_ISA=avx512-nohw asks for the ladders (see cpu_isa.h).
+ */
+#include "bitscan.h"
+
+#include "cpu_isa.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITSCAN_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*scan_kernel)(const unsigned *in, unsigned *out, size_t n);
+
+struct kernels {
+  scan_kernel popcount;
+  scan_kernel clz;
+  scan_kernel ctz;
+  scan_kernel ilog2;
+  scan_kernel next_pow2;
+  scan_kernel reverse;
+};
+
+// Scalar kernels, also used for the tail of every vector kernel
+#define DEFINE_SCALAR(name)                                                    \
+  static void name##_scalar(const unsigned *in, unsigned *out, size_t n) {     \
+    for (size_t i = 0; i < n; i++) {                                           \
+      out[i] = (unsigned)bit_##name(in[i]);                                    \
+    }                                                                          \
+  }
+
+DEFINE_SCALAR(popcount)
+DEFINE_SCALAR(clz)
+DEFINE_SCALAR(ctz)
+DEFINE_SCALAR(ilog2)
+DEFINE_SCALAR(next_pow2)
+DEFINE_SCALAR(reverse)
+
+#ifdef BITSCAN_X86
+
+/*
+ * DEFINE_KERNEL(name, isa, bytes) - one function for one instruction set. Each
+ *     vector is loaded before its store, so out may alias in.
+ */
+#define DEFINE_KERNEL(name, isa, bytes)                                        \
+  static void name##_##isa(const unsigned *in, unsigned *out, size_t n) {      \
+    const size_t lanes = (bytes) / sizeof(unsigned);                           \
+    size_t i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                       \
+      uvec_##isa x = *(const uvec_##isa *)(in + i);                            \
+      *(uvec_##isa *)(out + i) = (uvec_##isa)bit_##name##_##isa(x);            \
+    }                                                                          \
+    name##_scalar(in + i, out + i, n - i);                                     \
+  }
+
+/*
+ * DEFINE_KERNELS(isa, bytes) - the functions every instruction set has. The
+ * expansion must sit between target pragmas, since the portable functions
+ * come from a header macro that has no target attributes of its own.
+ */
+#define DEFINE_KERNELS(isa, bytes)                                             \
+  typedef int vec_##isa __attribute__((vector_size(bytes), aligned(4)));       \
+  typedef unsigned uvec_##isa __attribute__((vector_size(bytes), aligned(4))); \
+  DEFINE_BITSCAN_PORTABLE(isa, uvec_##isa, vec_##isa)                          \
+  DEFINE_KERNEL(popcount, isa, bytes)                                          \
+  DEFINE_KERNEL(ctz, isa, bytes)                                               \
+  DEFINE_KERNEL(next_pow2, isa, bytes)                                         \
+  DEFINE_KERNEL(reverse, isa, bytes)
+
+// clz and ilog2 run the smear and popcount ladders back to back, which over
+// four lanes is slower than the scalar BSR loop, so SSE2 uses that instead
+#pragma GCC push_options
+#pragma GCC target("sse2")
+DEFINE_KERNELS(sse2, 16)
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+DEFINE_KERNELS(avx2, 32)
+DEFINE_KERNEL(clz, avx2, 32)
+DEFINE_KERNEL(ilog2, avx2, 32)
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
+DEFINE_KERNELS(avx512, 64)
+DEFINE_KERNEL(clz, avx512, 64)
+DEFINE_KERNEL(ilog2, avx512, 64)
+#pragma GCC pop_options
+
+/*
+ * DEFINE_HW_KERNEL(name, isa_target, compute) - AVX-512 kernel that turns each
+ *     vector x into compute(x) with intrinsics.
+ */
+#define DEFINE_HW_KERNEL(name, isa_target, compute)                            \
+  __attribute__((target(isa_target))) static void name##_avx512_hw(            \
+      const unsigned *in, unsigned *out, size_t n) {                           \
+    const size_t lanes = sizeof(__m512i) / sizeof(unsigned);                   \
+    size_t i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                       \
+      __m512i x = _mm512_loadu_si512(in + i);                                  \
+      _mm512_storeu_si512(out + i, compute(x));                                \
+    }                                                                          \
+    name##_scalar(in + i, out + i, n - i);                                     \
+  }
+
+#define SPLAT(c) _mm512_set1_epi32(c)
+
+#define POPCOUNT_HW(x) _mm512_popcnt_epi32(x)
+
+#define CLZ_HW(x) _mm512_lzcnt_epi32(x)
+
+// ~x & (x - 1) has a set bit for each trailing zero
+#define CTZ_HW(x)                                                              \
+  _mm512_sub_epi32(SPLAT(32), CLZ_HW(_mm512_andnot_si512(                      \
+                                  x, _mm512_sub_epi32(x, SPLAT(1)))))
+
+#define ILOG2_HW(x) _mm512_sub_epi32(SPLAT(31), CLZ_HW(x))
+
+// Variable shifts by 32 or more give 0, which covers x > 2^31; x == 0 gives
+// 0 as well and is patched to 1
+#define NEXT_POW2_HW(x)                                                        \
+  _mm512_mask_mov_epi32(                                                       \
+      _mm512_sllv_epi32(SPLAT(1), _mm512_sub_epi32(                            \
+                                      SPLAT(32),                               \
+                                      CLZ_HW(_mm512_sub_epi32(x, SPLAT(1))))), \
+      _mm512_cmpeq_epi32_mask(x, _mm512_setzero_si512()), SPLAT(1))
+
+DEFINE_HW_KERNEL(popcount, "avx512f,avx512vpopcntdq", POPCOUNT_HW)
+DEFINE_HW_KERNEL(clz, "avx512f,avx512cd", CLZ_HW)
+DEFINE_HW_KERNEL(ctz, "avx512f,avx512cd", CTZ_HW)
+DEFINE_HW_KERNEL(ilog2, "avx512f,avx512cd", ILOG2_HW)
+DEFINE_HW_KERNEL(next_pow2, "avx512f,avx512cd", NEXT_POW2_HW)
+
+#endif
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static struct kernels active = {popcount_scalar,  clz_scalar,
+                                ctz_scalar,       ilog2_scalar,
+                                next_pow2_scalar, reverse_scalar};
+
+__attribute__((constructor)) static void select_kernels(void) {
+  switch (cpu_isa_level()) {
+#ifdef BITSCAN_X86
+  case ISA_AVX512:
+    active = (struct kernels){popcount_avx512,  clz_avx512,
+                              ctz_avx512,       ilog2_avx512,
+                              next_pow2_avx512, reverse_avx512};
+    if (cpu_isa_extras() && __builtin_cpu_supports("avx512vpopcntdq")) {
+      active.popcount = popcount_avx512_hw;
+    }
+    if (cpu_isa_extras() && __builtin_cpu_supports("avx512cd")) {
+      active.clz = clz_avx512_hw;
+      active.ctz = ctz_avx512_hw;
+      active.ilog2 = ilog2_avx512_hw;
+      active.next_pow2 = next_pow2_avx512_hw;
+    }
+    break;
+  case ISA_AVX2:
+    active = (struct kernels){popcount_avx2,  clz_avx2,       ctz_avx2,
+                              ilog2_avx2,     next_pow2_avx2, reverse_avx2};
+    break;
+  case ISA_SSE2:
+    active = (struct kernels){popcount_sse2,  clz_scalar,     ctz_sse2,
+                              ilog2_scalar,   next_pow2_sse2, reverse_sse2};
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+void bit_popcount_n(const unsigned *in, int *out, size_t n) {
+  active.popcount(in, (unsigned *)out, n);
+}
+
+void bit_clz_n(const unsigned *in, int *out, size_t n) {
+  active.clz(in, (unsigned *)out, n);
+}
+
+void bit_ctz_n(const unsigned *in, int *out, size_t n) {
+  active.ctz(in, (unsigned *)out, n);
+}
+
+void bit_ilog2_n(const unsigned *in, int *out, size_t n) {
+  active.ilog2(in, (unsigned *)out, n);
+}
+
+void bit_next_pow2_n(const unsigned *in, unsigned *out, size_t n) {
+  active.next_pow2(in, out, n);
+}
+
+void bit_reverse_n(const unsigned *in, unsigned *out, size_t n) {
+  active.reverse(in, out, n);
+}
@@ -0,0 +1,156 @@
+/*
+ * bitscan.h - Bit counting and scanning on 32-bit words, one at a time or in
+ *             batches.
+ *
+ *   bit_popcount(x)   number of set bits
+ *   bit_clz(x)        leading zero bits, 32 for x == 0
+ *   bit_ctz(x)        trailing zero bits, 32 for x == 0
+ *   bit_ilog2(x)      floor(log2(x)), -1 for x == 0
+ *   bit_next_pow2(x)  smallest power of 2 >= x; 1 for x == 0, and 0 when the
+ *                     answer does not fit (x > 2^31)
+ *   bit_reverse(x)    x with bit i moved to bit 31 - i
+ *
+ * Unlike the compiler builtins, every function is defined for 0. The plain
+ * versions use the builtins, and so the CPU's instructions where the target
+ * has them; the *_portable versions are the branch-free fallbacks used by
+ * other compilers. Those are written once by DEFINE_BITSCAN_PORTABLE for any
+ * unsigned type with 32-bit elements, which is also how bitscan.c builds its
+ * vector kernels.
+ */
+#ifndef BITSCAN_H
+#define BITSCAN_H
+
+#include <stddef.h>
+
+/*
+ * DEFINE_BITSCAN_PORTABLE(sfx, U, S) - The portable functions, suffixed sfx,
+ *     for the unsigned 32-bit type U; counts are returned as S, its signed
+ *     counterpart. U may be a GCC vector of unsigned ints, in which case each
+ *     lane is handled independently.
+ *
+ * Everything is built from two ladders: the SWAR popcount, which adds
+ * neighbouring bit fields of doubling width in parallel, and the smear, which
+ * ORs the highest set bit into every bit below it. The smear of x is
+ * 2^(ilog2(x) + 1) - 1, so its popcount is ilog2(x) + 1, and x & -x isolates
+ * the lowest set bit the same way for ctz.
+ */
+#define DEFINE_BITSCAN_PORTABLE(sfx, U, S)                                     \
+  static inline U bit_smear_##sfx(U x) {                                       \
+    x |= x >> 1;                                                               \
+    x |= x >> 2;                                                               \
+    x |= x >> 4;                                                               \
+    x |= x >> 8;                                                               \
+    x |= x >> 16;                                                              \
+    return x;                                                                  \
+  }                                                                            \
+                                                                               \
+  static inline S bit_popcount_##sfx(U x) {                                    \
+    x = x - ((x >> 1) & 0x55555555U);                                          \
+    x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);                          \
+    x = (x + (x >> 4)) & 0x0F0F0F0FU;                                          \
+    x += x >> 8;                                                               \
+    x += x >> 16;                                                              \
+    return (S)(x & 0x3FU);                                                     \
+  }                                                                            \
+                                                                               \
+  static inline S bit_clz_##sfx(U x) {                                         \
+    return (S)(32U - (U)bit_popcount_##sfx(bit_smear_##sfx(x)));               \
+  }                                                                            \
+                                                                               \
+  /* (x & -x) - 1 has a set bit for each trailing zero, all 32 for x == 0 */   \
+  static inline S bit_ctz_##sfx(U x) {                                         \
+    return bit_popcount_##sfx((x & (0U - x)) - 1U);                            \
+  }                                                                            \
+                                                                               \
+  static inline S bit_ilog2_##sfx(U x) {                                       \
+    return (S)((U)bit_popcount_##sfx(bit_smear_##sfx(x)) - 1U);                \
+  }                                                                            \
+                                                                               \
+  /* x - 1 wraps for x == 0, leaving 0, so 1 is added back for that case */    \
+  static inline U bit_next_pow2_##sfx(U x) {                                   \
+    return bit_smear_##sfx(x - 1U) + 1U + ((U)(x == 0) & 1U);                  \
+  }                                                                            \
+                                                                               \
+  /* Swaps ever smaller halves: 16-bit, byte, nibble, pair, then bit */        \
+  static inline U bit_reverse_##sfx(U x) {                                     \
+    x = (x >> 16) | (x << 16);                                                 \
+    x = ((x >> 8) & 0x00FF00FFU) | ((x & 0x00FF00FFU) << 8);                   \
+    x = ((x >> 4) & 0x0F0F0F0FU) | ((x & 0x0F0F0F0FU) << 4);                   \
+    x = ((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);                   \
+    x = ((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);                   \
+    return x;                                                                  \
+  }
+
+DEFINE_BITSCAN_PORTABLE(portable, unsigned, int)
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_bitreverse32)
+#define BITSCAN_HAVE_BITREVERSE
+#endif
+#endif
+
+/*
+ * x86 only has a popcount instruction with POPCNT (-mpopcnt or a -march that
+ * includes it); without it __builtin_popcount is a libgcc call, no faster
+ * than the inline SWAR version and opaque to the vectorizer.
+ */
+#if defined(__GNUC__) &&                                                       \
+    (defined(__POPCNT__) || !(defined(__x86_64__) || defined(__i386__)))
+#define BITSCAN_HAVE_POPCOUNT
+#endif
+
+static inline int bit_popcount(unsigned x) {
+#ifdef BITSCAN_HAVE_POPCOUNT
+  return __builtin_popcount(x);
+#else
+  return bit_popcount_portable(x);
+#endif
+}
+
+// The x == 0 checks compile away where the instruction already returns 32
+// (LZCNT, TZCNT) and to a conditional move elsewhere
+static inline int bit_clz(unsigned x) {
+#ifdef __GNUC__
+  return (x == 0) ? 32 : __builtin_clz(x);
+#else
+  return bit_clz_portable(x);
+#endif
+}
+
+static inline int bit_ctz(unsigned x) {
+#ifdef __GNUC__
+  return (x == 0) ? 32 : __builtin_ctz(x);
+#else
+  return bit_ctz_portable(x);
+#endif
+}
+
+static inline int bit_ilog2(unsigned x) { return 31 - bit_clz(x); }
+
+// Shifting in 64 bits makes the x > 2^31 case (a shift by 32) come out as 0
+static inline unsigned bit_next_pow2(unsigned x) {
+  return (unsigned)(1ULL << (32 - bit_clz(x - 1U))) | (x == 0);
+}
+
+// GCC has no bit-reverse builtin, but it already turns the first two steps of
+// the portable version into a byte swap
+static inline unsigned bit_reverse(unsigned x) {
+#ifdef BITSCAN_HAVE_BITREVERSE
+  return __builtin_bitreverse32(x);
+#else
+  return bit_reverse_portable(x);
+#endif
+}
+
+/*
+ * Batch versions: out[i] = bit_*(in[i]) for n elements, with SSE2, AVX2 or
+ * AVX-512 kernels picked at startup (see cpu_isa.h). out may alias in.
+ */
+void bit_popcount_n(const unsigned *in, int *out, size_t n);
+void bit_clz_n(const unsigned *in, int *out, size_t n);
+void bit_ctz_n(const unsigned *in, int *out, size_t n);
+void bit_ilog2_n(const unsigned *in, int *out, size_t n);
+void bit_next_pow2_n(const unsigned *in, unsigned *out, size_t n);
+void bit_reverse_n(const unsigned *in, unsigned *out, size_t n);
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * bitsfn.h - Prototypes for the solutions in bits.c, for code that links
+ *            against bits.c instead of going through btest.
+ */
+#ifndef BITSFN_H
+#define BITSFN_H
+
+int isTmax(int x);
+int evenBits(void);
+int isEqual(int x, int y);
+int fitsBits(int x, int n);
+int conditional(int x, int y, int z);
+int isGreater(int x, int y);
+int multFiveEighths(int x);
+int logicalNeg(int x);
+int twosComp2SignMag(int x);
+int isPower2(int x);
+
+#endif
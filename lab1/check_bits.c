@@ -0,0 +1,183 @@
+/*
+ * check_bits.c - Exhaustive check of the bits.c solutions against plain C
+ *                reference implementations.
+ *
+ * Unary functions are checked on all 2^32 inputs. Binary functions get the
+ * edge pairs, dense square and random pairs of exhaustive_binary; the third
+ * argument of conditional is derived from the other two, and the n of
+ * fitsBits is (y & 31) + 1. evenBits takes no input and is checked once.
+ *
+ * bits.c is included directly, so each check loop inlines the solution and
+ * the reference and the compiler can vectorize both; build with -O3
+ * -march=native for the widest vectors. The work is spread over all cores.
+ *
+ * Build: gcc -O3 -march=native -pthread -o check_bits check_bits.c exhaustive.c
+ * Usage: check_bits [-r random_pairs] [function...]
+ */
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bits.c"
+#include "exhaustive.h"
+
+#define RANDOM_PAIRS (1ULL << 28) /* default random pairs per binary check */
+
+/*
+ * DEFINE_CHECK(id, valid, got, want) - the check callback for one function.
+ *     got is the bits.c call and want the reference, both expressions of x
+ *     and y; inputs where valid is false are outside the function's contract
+ *     and not compared. id##_got and id##_want are also defined, for
+ *     reporting a failure.
+ */
+#define DEFINE_CHECK(id, valid, got, want)                                     \
+  static inline int id##_got(int x, int y) {                                   \
+    (void)y;                                                                   \
+    return (got);                                                              \
+  }                                                                            \
+                                                                               \
+  static inline int id##_want(int x, int y) {                                  \
+    (void)y;                                                                   \
+    return (want);                                                             \
+  }                                                                            \
+                                                                               \
+  static size_t id##_check(void *ctx, const int32_t *xs, const int32_t *ys,    \
+                           size_t n) {                                         \
+    int differs = 0;                                                           \
+    (void)ctx;                                                                 \
+    for (size_t i = 0; i < n; i++) {                                           \
+      int x = xs[i];                                                           \
+      int y = ys[i];                                                           \
+      (void)y;                                                                 \
+      differs |= (id##_got(x, y) ^ id##_want(x, y)) & -(int)(valid);           \
+    }                                                                          \
+    if (differs == 0) {                                                        \
+      return n;                                                                \
+    }                                                                          \
+    for (size_t i = 0; i < n; i++) {                                           \
+      int x = xs[i];                                                           \
+      int y = ys[i];                                                           \
+      (void)y;                                                                 \
+      if ((valid) && id##_got(x, y) != id##_want(x, y)) {                      \
+        return i;                                                              \
+      }                                                                        \
+    }                                                                          \
+    return n;                                                                  \
+  }
+
+// fitsBits takes 1 <= n <= 32
+#define FITS_N ((y & 31) + 1)
+
+// conditional's z: the complement of y, so every bit shows which side won
+#define COND_Z (~y)
+
+/*
+ * References, written with unsigned or 64-bit arithmetic so that overflow
+ * wraps the way the dlc rules assume instead of being undefined
+ */
+DEFINE_CHECK(is_tmax, 1, isTmax(x), x == INT_MAX)
+DEFINE_CHECK(is_equal, 1, isEqual(x, y), x == y)
+DEFINE_CHECK(fits_bits, 1, fitsBits(x, FITS_N),
+             (int64_t)x >= -(1LL << (FITS_N - 1)) &&
+                 (int64_t)x < (1LL << (FITS_N - 1)))
+DEFINE_CHECK(conditional, 1, conditional(x, y, COND_Z), x ? y : COND_Z)
+DEFINE_CHECK(is_greater, 1, isGreater(x, y), x > y)
+DEFINE_CHECK(mult_five_eighths, 1, multFiveEighths(x),
+             (int)((unsigned)x * 5U) / 8)
+DEFINE_CHECK(logical_neg, 1, logicalNeg(x), !x)
+// twosComp2SignMag assumes x > Tmin
+DEFINE_CHECK(twos_comp_2_sign_mag, x != INT_MIN, twosComp2SignMag(x),
+             x < 0 ? (int)(0x80000000U | (0U - (unsigned)x)) : x)
+DEFINE_CHECK(is_power2, 1, isPower2(x), x > 0 && (x & (x - 1)) == 0)
+
+typedef struct {
+  const char *name;
+  int arity;
+  exhaustive_fn check;
+  int (*got)(int x, int y);
+  int (*want)(int x, int y);
+} function_t;
+
+#define FUNCTION(name, arity, id)                                              \
+  { name, arity, id##_check, id##_got, id##_want }
+
+static const function_t FUNCTIONS[] = {
+    FUNCTION("isTmax", 1, is_tmax),
+    FUNCTION("isEqual", 2, is_equal),
+    FUNCTION("fitsBits", 2, fits_bits),
+    FUNCTION("conditional", 2, conditional),
+    FUNCTION("isGreater", 2, is_greater),
+    FUNCTION("multFiveEighths", 1, mult_five_eighths),
+    FUNCTION("logicalNeg", 1, logical_neg),
+    FUNCTION("twosComp2SignMag", 1, twos_comp_2_sign_mag),
+    FUNCTION("isPower2", 1, is_power2),
+};
+
+static double seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Runs one function's check and prints the outcome. Returns true if it passed.
+static bool check_function(const function_t *function, uint64_t random_pairs) {
+  int32_t bad_x = 0;
+  int32_t bad_y = 0;
+  double start = seconds();
+  bool ok = (function->arity == 1)
+                ? exhaustive_unary(function->check, NULL, &bad_x, &bad_y)
+                : exhaustive_binary(function->check, NULL, random_pairs,
+                                    &bad_x, &bad_y);
+  double elapsed = seconds() - start;
+
+  if (ok) {
+    printf("%-17s ok    %s in %.2f s\n", function->name,
+           (function->arity == 1) ? "all 2^32 inputs" : "structured + random",
+           elapsed);
+  } else if (function->arity == 1) {
+    printf("%-17s FAIL  x = %d (0x%08x): got %d, want %d\n", function->name,
+           bad_x, (unsigned)bad_x, function->got(bad_x, bad_y),
+           function->want(bad_x, bad_y));
+  } else {
+    printf("%-17s FAIL  x = %d, y = %d: got %d, want %d\n", function->name,
+           bad_x, bad_y, function->got(bad_x, bad_y),
+           function->want(bad_x, bad_y));
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  uint64_t random_pairs = RANDOM_PAIRS;
+  bool all_ok = true;
+  int opt = 0;
+
+  while ((opt = getopt(argc, argv, "r:")) != -1) {
+    if (opt != 'r') {
+      fprintf(stderr, "usage: %s [-r random_pairs] [function...]\n", argv[0]);
+      return 2;
+    }
+    random_pairs = strtoull(optarg, NULL, 0);
+  }
+
+  // evenBits has no input to sweep
+  if (optind == argc || strcmp(argv[optind], "evenBits") == 0) {
+    bool ok = evenBits() == 0x55555555;
+    printf("%-17s %s\n", "evenBits", ok ? "ok" : "FAIL");
+    all_ok = all_ok && ok;
+  }
+
+  for (size_t i = 0; i < sizeof(FUNCTIONS) / sizeof(*FUNCTIONS); i++) {
+    bool selected = optind == argc;
+    for (int arg = optind; arg < argc; arg++) {
+      selected = selected || strcmp(argv[arg], FUNCTIONS[i].name) == 0;
+    }
+    if (selected && !check_function(&FUNCTIONS[i], random_pairs)) {
+      all_ok = false;
+    }
+  }
+  return all_ok ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+/*
+ * check_bits_vec.c - Check of the bits_vec.c kernels against bits.c.
+ *
+ * Every array function, in its 0/1 and its mask form, is compared element by
+ * element with the bits.c function it vectorizes. logicalNeg, isPower2 and
+ * fitsBits get all 2^32 inputs, fitsBits with one width per block of 1024
+ * inputs and then with every width on the edge values of exhaustive.c, which
+ * lie on both sides of each width's limits. isEqual and isGreater get the
+ * pairs of exhaustive_binary (-r sets how many random ones).
+ *
+ * Each batch of inputs is cut into arrays of 0 to MAX_PIECE elements, so the
+ * vector loops run with every tail length the kernels can leave, and the
+ * element after each array must come back untouched.
+ *
+ * The kernels are picked once at startup, so the checker runs itself again
+ * with BITS_ISA set to each level this CPU supports (see cpu_isa.h); setting
+ * BITS_ISA beforehand checks just that level.
+ *
+ * Build: gcc -O2 -pthread -o check_bits_vec check_bits_vec.c bits_vec.c
+ *            bits.c cpu_isa.c exhaustive.c
+ * Usage: check_bits_vec [-r random_pairs]
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bits_vec.h"
+#include "bitsfn.h"
+#include "cpu_isa.h"
+#include "exhaustive.h"
+
+#define MAX_PIECE 35              /* longest array passed to one kernel call */
+#define SENTINEL 0x5A5A5A5A       /* never a kernel result */
+#define RANDOM_PAIRS (1ULL << 26) /* default random pairs for binary checks */
+
+enum function {
+  IS_EQUAL,
+  IS_GREATER,
+  FITS_BITS,
+  LOGICAL_NEG,
+  IS_POWER2,
+  FUNCTIONS
+};
+
+static const char *const FUNCTION_NAMES[FUNCTIONS] = {
+    "isEqual", "isGreater", "fitsBits", "logicalNeg", "isPower2"};
+
+static const char *const LEVEL_NAMES[] = {"scalar", "sse2", "avx2", "avx512"};
+
+// What check_function found wrong, when it is given somewhere to put it
+typedef struct {
+  enum function function; // FUNCTIONS if nothing failed
+  bool mask;
+  int bits;
+  int got;
+  int want;
+  bool overrun;  // the kernel wrote past an array
+  size_t length; // of that many elements
+} failure_t;
+
+// One kernel call, to the _mask_n form if mask is set
+static void run_kernel(enum function function, bool mask, const int *x,
+                       const int *y, int bits, int *out, size_t n) {
+  switch (function) {
+  case IS_EQUAL:
+    (mask ? isEqual_mask_n : isEqual_n)(x, y, out, n);
+    break;
+  case IS_GREATER:
+    (mask ? isGreater_mask_n : isGreater_n)(x, y, out, n);
+    break;
+  case FITS_BITS:
+    (mask ? fitsBits_mask_n : fitsBits_n)(x, bits, out, n);
+    break;
+  case LOGICAL_NEG:
+    (mask ? logicalNeg_mask_n : logicalNeg_n)(x, out, n);
+    break;
+  default:
+    (mask ? isPower2_mask_n : isPower2_n)(x, out, n);
+    break;
+  }
+}
+
+static int reference(enum function function, int x, int y, int bits) {
+  switch (function) {
+  case IS_EQUAL:
+    return isEqual(x, y);
+  case IS_GREATER:
+    return isGreater(x, y);
+  case FITS_BITS:
+    return fitsBits(x, bits);
+  case LOGICAL_NEG:
+    return logicalNeg(x);
+  default:
+    return isPower2(x);
+  }
+}
+
+/*
+ * check_function - Run both forms of one function over x[0..n) (and y) in
+ *     arrays of 0 to MAX_PIECE elements and compare each element with bits.c.
+ *     Returns the index of the first mismatch, or n. A write past an array is
+ *     blamed on its last element, or on the next one for an empty array.
+ */
+static size_t check_function(enum function function, int bits,
+                             const int32_t *x, const int32_t *y, size_t n,
+                             failure_t *failure) {
+  int want[EXHAUSTIVE_BATCH];
+  int out[EXHAUSTIVE_BATCH + 1];
+
+  for (size_t i = 0; i < n; i++) {
+    want[i] = reference(function, x[i], y[i], bits);
+  }
+
+  for (int mask = 0; mask < 2; mask++) {
+    size_t start = 0;
+    for (size_t piece = 0; start < n; piece++) {
+      size_t length = piece % (MAX_PIECE + 1);
+      if (length > n - start) {
+        length = n - start;
+      }
+
+      out[start + length] = SENTINEL;
+      run_kernel(function, mask, x + start, y + start, bits, out + start,
+                 length);
+      if (out[start + length] != SENTINEL) {
+        size_t bad = (length == 0) ? start : start + length - 1;
+        if (failure != NULL) {
+          *failure = (failure_t){function, mask, bits, 0, 0, true, length};
+        }
+        return bad;
+      }
+
+      for (size_t i = start; i < start + length; i++) {
+        int expected = mask ? -want[i] : want[i];
+        if (out[i] != expected) {
+          if (failure != NULL) {
+            *failure =
+                (failure_t){function, mask, bits, out[i], expected, false, 0};
+          }
+          return i;
+        }
+      }
+      start += length;
+    }
+  }
+  return n;
+}
+
+// fitsBits width for a block of 1024 unary inputs, so each one is checked
+// with a single width and every width gets 2^27 inputs
+static int unary_width(int32_t x) { return 1 + (int)((uint32_t)x >> 10) % 32; }
+
+// exhaustive_fn: the unary functions on x[0..n). ctx is a failure_t or NULL.
+static size_t check_unary(void *ctx, const int32_t *x, const int32_t *y,
+                          size_t n) {
+  static const enum function UNARY[] = {FITS_BITS, LOGICAL_NEG, IS_POWER2};
+
+  for (size_t f = 0; f < sizeof(UNARY) / sizeof(*UNARY); f++) {
+    size_t bad = check_function(UNARY[f], unary_width(x[0]), x, y, n, ctx);
+    if (bad < n) {
+      return bad;
+    }
+  }
+  return n;
+}
+
+// exhaustive_fn: the binary functions on the pairs in x and y
+static size_t check_binary(void *ctx, const int32_t *x, const int32_t *y,
+                           size_t n) {
+  for (int function = IS_EQUAL; function <= IS_GREATER; function++) {
+    size_t bad = check_function(function, 0, x, y, n, ctx);
+    if (bad < n) {
+      return bad;
+    }
+  }
+  return n;
+}
+
+static void print_failure(const failure_t *failure, int32_t x, int32_t y) {
+  const char *level = LEVEL_NAMES[cpu_isa_level()];
+  const char *form = failure->mask ? "_mask_n" : "_n";
+  char args[32];
+
+  if (failure->function == FUNCTIONS) {
+    printf("%-6s FAIL  x = %d, y = %d, but not when checked again alone\n",
+           level, x, y);
+    return;
+  }
+  if (failure->overrun) {
+    printf("%-6s FAIL  %s%s wrote past the end of a %zu-element array\n",
+           level, FUNCTION_NAMES[failure->function], form, failure->length);
+    return;
+  }
+
+  if (failure->function <= IS_GREATER) {
+    snprintf(args, sizeof(args), "%d, %d", x, y);
+  } else if (failure->function == FITS_BITS) {
+    snprintf(args, sizeof(args), "%d, %d", x, failure->bits);
+  } else {
+    snprintf(args, sizeof(args), "%d", x);
+  }
+  printf("%-6s FAIL  %s%s(%s): got %d, want %d\n", level,
+         FUNCTION_NAMES[failure->function], form, args, failure->got,
+         failure->want);
+}
+
+/*
+ * recheck - Report the earliest failing input of a sweep. It is checked again
+ *     in a batch of nothing but copies of itself, so it still lands in every
+ *     vector lane and in the tails.
+ */
+static void recheck(exhaustive_fn check, int32_t x, int32_t y) {
+  int32_t xs[EXHAUSTIVE_BATCH];
+  int32_t ys[EXHAUSTIVE_BATCH];
+  failure_t failure = {FUNCTIONS, false, 0, 0, 0, false, 0};
+
+  for (size_t i = 0; i < EXHAUSTIVE_BATCH; i++) {
+    xs[i] = x;
+    ys[i] = y;
+  }
+  check(&failure, xs, ys, EXHAUSTIVE_BATCH);
+  print_failure(&failure, x, y);
+}
+
+// Checks every function at the current ISA level. Returns true if all pass.
+static bool check_level(uint64_t random_pairs) {
+  int32_t edges[EXHAUSTIVE_EDGES];
+  int32_t zeros[EXHAUSTIVE_EDGES] = {0};
+  size_t count = exhaustive_edge_values(edges);
+  failure_t failure = {FUNCTIONS, false, 0, 0, 0, false, 0};
+  int32_t bad_x = 0;
+  int32_t bad_y = 0;
+
+  for (int bits = 1; bits <= 32; bits++) {
+    size_t bad = check_function(FITS_BITS, bits, edges, zeros, count, &failure);
+    if (bad < count) {
+      print_failure(&failure, edges[bad], 0);
+      return false;
+    }
+  }
+
+  if (!exhaustive_unary(check_unary, NULL, &bad_x, &bad_y)) {
+    recheck(check_unary, bad_x, bad_y);
+    return false;
+  }
+  if (!exhaustive_binary(check_binary, NULL, random_pairs, &bad_x, &bad_y)) {
+    recheck(check_binary, bad_x, bad_y);
+    return false;
+  }
+
+  printf("%-6s ok\n", LEVEL_NAMES[cpu_isa_level()]);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  uint64_t random_pairs = RANDOM_PAIRS;
+  int opt = 0;
+
+  while ((opt = getopt(argc, argv, "r:")) != -1) {
+    switch (opt) {
+    case 'r':
+      random_pairs = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-r random_pairs]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (getenv("BITS_ISA") != NULL) {
+    return check_level(random_pairs) ? 0 : 1;
+  }
+
+  // One child per level, each picking its kernels at startup
+  int status = 0;
+  for (int level = ISA_SCALAR; level <= (int)cpu_isa_level(); level++) {
+    pid_t child = fork();
+    if (child == 0) {
+      setenv("BITS_ISA", LEVEL_NAMES[level], 1);
+      execv("/proc/self/exe", argv);
+      perror("execv");
+      _exit(2);
+    }
+
+    int child_status = 0;
+    if (child < 0 || waitpid(child, &child_status, 0) < 0 ||
+        !WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0) {
+      status = 1;
+    }
+  }
+  return status;
+}
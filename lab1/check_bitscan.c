@@ -0,0 +1,227 @@
+/*
+ * check_bitscan.c - Exhaustive check of bitscan.h and bitscan.c.
+ *
+ * Every 32-bit input goes through the builtin-based functions, the portable
+ * ones and the batch kernels, and each result is compared with a reference
+ * built from 16-bit tables that are filled by testing one bit at a time, so
+ * it shares no code or trick with what it checks.
+ *
+ * The batch kernels are picked once at startup, so the checker runs itself
+ * again with BITS_ISA set to each level this CPU supports (see cpu_isa.h),
+ * and at AVX-512 once more with avx512-nohw for the kernels that do without
+ * AVX512CD and AVX512_VPOPCNTDQ. Setting BITS_ISA beforehand checks just that
+ * level.
+ *
+ * Build: gcc -O2 -pthread -o check_bitscan check_bitscan.c bitscan.c cpu_isa.c
+ *            exhaustive.c
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bitscan.h"
+#include "cpu_isa.h"
+#include "exhaustive.h"
+
+enum function {
+  POPCOUNT,
+  CLZ,
+  CTZ,
+  ILOG2,
+  NEXT_POW2,
+  REVERSE,
+  FUNCTIONS
+};
+
+static const char *const FUNCTION_NAMES[FUNCTIONS] = {
+    "popcount", "clz", "ctz", "ilog2", "next_pow2", "reverse"};
+
+enum variant { BUILTIN, PORTABLE, BATCH, VARIANTS };
+
+static const char *const VARIANT_NAMES[VARIANTS] = {"builtin", "portable",
+                                                    "batch"};
+
+static const char *const LEVEL_NAMES[] = {"scalar", "sse2", "avx2", "avx512"};
+static const char NOHW_NAME[] = "avx512-nohw";
+
+// Per 16-bit half: set bits, leading and trailing zeros (16 for 0), reversal
+static uint8_t half_popcount[1 << 16];
+static uint8_t half_clz[1 << 16];
+static uint8_t half_ctz[1 << 16];
+static uint16_t half_reverse[1 << 16];
+
+static void init_tables(void) {
+  for (uint32_t x = 0; x < (1U << 16); x++) {
+    half_clz[x] = 16;
+    half_ctz[x] = 16;
+    for (int bit = 0; bit < 16; bit++) {
+      if (x & (1U << bit)) {
+        half_popcount[x]++;
+        half_reverse[x] |= (uint16_t)(1U << (15 - bit));
+        half_clz[x] = (uint8_t)(15 - bit);
+        if (half_ctz[x] == 16) {
+          half_ctz[x] = (uint8_t)bit;
+        }
+      }
+    }
+  }
+}
+
+static unsigned reference_clz(uint32_t x) {
+  return (x >> 16) ? half_clz[x >> 16] : 16U + half_clz[x & 0xFFFF];
+}
+
+static unsigned reference(enum function function, uint32_t x) {
+  switch (function) {
+  case POPCOUNT:
+    return half_popcount[x & 0xFFFF] + half_popcount[x >> 16];
+  case CLZ:
+    return reference_clz(x);
+  case CTZ:
+    return (x & 0xFFFF) ? half_ctz[x & 0xFFFF] : 16U + half_ctz[x >> 16];
+  case ILOG2:
+    return 31U - reference_clz(x);
+  case NEXT_POW2:
+    // 1 for 0, and 2^32 truncated to 0 above 2^31
+    return (x == 0) ? 1U : (uint32_t)(1ULL << (32 - reference_clz(x - 1)));
+  default:
+    return (uint32_t)half_reverse[x & 0xFFFF] << 16 | half_reverse[x >> 16];
+  }
+}
+
+// The builtin and portable results of bit_##fn on in[0..n), as arrays so
+// that the loop vectorizes
+#define SCALAR_RESULTS(fn)                                                     \
+  for (size_t i = 0; i < n; i++) {                                             \
+    got[BUILTIN][i] = (unsigned)bit_##fn(in[i]);                               \
+    got[PORTABLE][i] = (unsigned)bit_##fn##_portable(in[i]);                   \
+  }
+
+// The first function and variant that fails, recorded by check_batch
+typedef struct {
+  enum function function;
+  enum variant variant;
+  unsigned got;
+} failure_t;
+
+// exhaustive_fn: every function and variant on x[0..n)
+static size_t check_batch(void *ctx, const int32_t *x, const int32_t *ys,
+                          size_t n) {
+  const unsigned *in = (const unsigned *)x;
+  unsigned want[EXHAUSTIVE_BATCH];
+  unsigned got[VARIANTS][EXHAUSTIVE_BATCH];
+  failure_t *failure = ctx;
+
+  (void)ys;
+  for (int function = 0; function < FUNCTIONS; function++) {
+    switch (function) {
+    case POPCOUNT:
+      SCALAR_RESULTS(popcount)
+      bit_popcount_n(in, (int *)got[BATCH], n);
+      break;
+    case CLZ:
+      SCALAR_RESULTS(clz)
+      bit_clz_n(in, (int *)got[BATCH], n);
+      break;
+    case CTZ:
+      SCALAR_RESULTS(ctz)
+      bit_ctz_n(in, (int *)got[BATCH], n);
+      break;
+    case ILOG2:
+      SCALAR_RESULTS(ilog2)
+      bit_ilog2_n(in, (int *)got[BATCH], n);
+      break;
+    case NEXT_POW2:
+      SCALAR_RESULTS(next_pow2)
+      bit_next_pow2_n(in, got[BATCH], n);
+      break;
+    default:
+      SCALAR_RESULTS(reverse)
+      bit_reverse_n(in, got[BATCH], n);
+      break;
+    }
+
+    unsigned differs = 0;
+    for (size_t i = 0; i < n; i++) {
+      want[i] = reference(function, in[i]);
+      differs |= (got[BUILTIN][i] ^ want[i]) | (got[PORTABLE][i] ^ want[i]) |
+                 (got[BATCH][i] ^ want[i]);
+    }
+    if (differs == 0) {
+      continue;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      for (int variant = 0; variant < VARIANTS; variant++) {
+        if (got[variant][i] != want[i]) {
+          // Threads can race here, but main rechecks the earliest failing
+          // input on its own before printing this
+          *failure = (failure_t){function, variant, got[variant][i]};
+          return i;
+        }
+      }
+    }
+  }
+  return n;
+}
+
+// Checks all inputs at the current ISA level. Returns true if they pass.
+static bool check_level(void) {
+  const char *level = cpu_isa_extras() ? LEVEL_NAMES[cpu_isa_level()]
+                                       : NOHW_NAME;
+  failure_t failure = {POPCOUNT, BUILTIN, 0};
+  int32_t bad = 0;
+  int32_t unused = 0;
+
+  if (exhaustive_unary(check_batch, &failure, &bad, &unused)) {
+    printf("%-11s ok\n", level);
+    return true;
+  }
+
+  // Recheck the earliest failing input alone, for a consistent report
+  check_batch(&failure, &bad, &unused, 1);
+  printf("%-11s FAIL  %s %s(0x%08x): got 0x%x, want 0x%x\n", level,
+         VARIANT_NAMES[failure.variant], FUNCTION_NAMES[failure.function],
+         (unsigned)bad, failure.got,
+         reference(failure.function, (uint32_t)bad));
+  return false;
+}
+
+int main(int argc, char **argv) {
+  init_tables();
+  (void)argc;
+
+  if (getenv("BITS_ISA") != NULL) {
+    return check_level() ? 0 : 1;
+  }
+
+  // One child per level, each picking its kernels at startup
+  const char *runs[ISA_AVX512 + 2];
+  int run_count = 0;
+  for (int level = ISA_SCALAR; level <= (int)cpu_isa_level(); level++) {
+    runs[run_count++] = LEVEL_NAMES[level];
+  }
+  if (cpu_isa_level() == ISA_AVX512) {
+    runs[run_count++] = NOHW_NAME;
+  }
+
+  int status = 0;
+  for (int run = 0; run < run_count; run++) {
+    pid_t child = fork();
+    if (child == 0) {
+      setenv("BITS_ISA", runs[run], 1);
+      execv("/proc/self/exe", argv);
+      perror("execv");
+      _exit(2);
+    }
+
+    int child_status = 0;
+    if (child < 0 || waitpid(child, &child_status, 0) < 0 ||
+        !WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0) {
+      status = 1;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,203 @@
+/*
+ * check_fixscale.c - Exhaustive check of fixscale.c against (int64_t)x * p / q.
+ *
+ * Every entry point is compared with the C expression: fixscale_wide,
+ * fixscale, fixscale_checked, and the batch kernels fixscale_n and
+ * fixscale_sat_n (values and clamp count). Edge gains (the int extremes, signs
+ * in every combination, 5/8, thirds, large primes) are checked on all 2^32
+ * inputs; random gains and p/2^k for every k get a sample of inputs spread
+ * over the whole range. -q samples the edge gains too, for a quick run.
+ *
+ * The batch kernels are picked once at startup, so the checker runs itself
+ * again with BITS_ISA set to each level this CPU supports (see cpu_isa.h);
+ * setting BITS_ISA beforehand checks just that level.
+ *
+ * Build: gcc -O2 -pthread -o check_fixscale check_fixscale.c fixscale.c
+ *            cpu_isa.c exhaustive.c
+ * Usage: check_fixscale [-q] [-g random_gains] [-s samples]
+ */
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cpu_isa.h"
+#include "exhaustive.h"
+#include "fixscale.h"
+
+#define RANDOM_GAINS 1000    /* default random p/q gains */
+#define SAMPLES (1U << 16)   /* default inputs per sampled gain */
+#define SAMPLE_STRIDE 40503U /* odd, so samples never repeat */
+#define MAX_POW2_SHIFT 62    /* largest k for fixscale_init_pow2 */
+
+static const int EDGE_GAINS[][2] = {
+    {5, 8}, {1, 1}, {-1, 1}, {1, -1}, {-5, -8}, {1, 2}, {1, 3}, {-7, 3}, {2, 3},
+    {1000, 7}, {3, 1000000007}, {1, INT_MAX}, {INT_MAX, 1}, {INT_MAX, 3},
+    {INT_MAX, INT_MAX}, {INT_MIN, 1}, {INT_MIN, -1}, {INT_MIN, 7},
+    {INT_MIN, 65536}, {INT_MIN, INT_MIN}, {INT_MAX, INT_MIN},
+    {123456789, -987654},
+};
+
+static const char *const LEVEL_NAMES[] = {"scalar", "sse2", "avx2", "avx512"};
+
+typedef struct {
+  fixscale_t scale;
+  int64_t p;
+  int64_t q;       // 2^k for fixscale_init_pow2 gains
+  uint32_t stride; // input checked at index i: i * stride
+} gain_t;
+
+// exhaustive_fn: checks every entry point on the inputs with indices xs[i]
+static size_t check_gain(void *ctx, const int32_t *xs, const int32_t *ys,
+                         size_t n) {
+  const gain_t *gain = ctx;
+  int x[EXHAUSTIVE_BATCH] = {0};
+  int out[EXHAUSTIVE_BATCH];
+  int sat[EXHAUSTIVE_BATCH];
+  size_t want_clamped = 0;
+
+  (void)ys;
+  for (size_t i = 0; i < n; i++) {
+    x[i] = (int)((uint32_t)xs[i] * gain->stride);
+  }
+  fixscale_n(&gain->scale, x, out, n);
+  size_t clamped = fixscale_sat_n(&gain->scale, x, sat, n);
+
+  for (size_t i = 0; i < n; i++) {
+    int64_t want = (int64_t)x[i] * gain->p / gain->q;
+    int64_t want_sat = (want > INT_MAX) ? INT_MAX
+                       : (want < INT_MIN) ? INT_MIN
+                                          : want;
+    int checked = 0;
+    int status = fixscale_checked(&gain->scale, x[i], &checked);
+
+    if (fixscale_wide(&gain->scale, x[i]) != want ||
+        fixscale(&gain->scale, x[i]) != (int)want || out[i] != (int)want ||
+        sat[i] != want_sat || checked != (int)want ||
+        status != ((want == want_sat) ? 0 : -1)) {
+      return i;
+    }
+    want_clamped += want != want_sat;
+  }
+  // Every value is right but the count is not; blame the first input
+  return (clamped == want_clamped) ? n : 0;
+}
+
+// Checks one gain on count inputs. Returns true if they all pass.
+static bool check(const gain_t *gain, uint64_t count) {
+  int32_t bad = 0;
+  int32_t unused = 0;
+
+  if (exhaustive_indices(check_gain, (void *)gain, count, &bad, &unused)) {
+    return true;
+  }
+
+  int x = (int)((uint32_t)bad * gain->stride);
+  int64_t want = (int64_t)x * gain->p / gain->q;
+  printf("FAIL  %lld/%lld, x = %d: want %lld, fixscale_wide %lld\n",
+         (long long)gain->p, (long long)gain->q, x, (long long)want,
+         (long long)fixscale_wide(&gain->scale, x));
+  return false;
+}
+
+// xorshift64*, so random gains are the same on every run
+static uint64_t next_random(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Checks every gain at the current ISA level. Returns true if all pass.
+static bool check_level(bool quick, unsigned random_gains, uint64_t samples) {
+  const char *level = LEVEL_NAMES[cpu_isa_level()];
+  uint64_t state = 1;
+  bool ok = true;
+
+  for (size_t i = 0; i < sizeof(EDGE_GAINS) / sizeof(*EDGE_GAINS); i++) {
+    gain_t gain = {{0}, EDGE_GAINS[i][0], EDGE_GAINS[i][1], 1};
+
+    fixscale_init(&gain.scale, EDGE_GAINS[i][0], EDGE_GAINS[i][1]);
+    if (quick) {
+      gain.stride = SAMPLE_STRIDE;
+    }
+    ok = check(&gain, quick ? samples : 1ULL << 32) && ok;
+  }
+  printf("%-6s %s edge gains\n", level, quick ? "sampled" : "all inputs of");
+
+  for (unsigned i = 0; i < random_gains; i++) {
+    uint64_t r = next_random(&state);
+    int p = (int)(uint32_t)r;
+    int q = (int)(uint32_t)(r >> 32) >> (r % 31);
+    gain_t gain = {{0}, p, (q == 0) ? 1 : q, SAMPLE_STRIDE};
+
+    fixscale_init(&gain.scale, p, (int)gain.q);
+    ok = check(&gain, samples) && ok;
+  }
+  printf("%-6s sampled %u random gains\n", level, random_gains);
+
+  for (int k = 0; k <= MAX_POW2_SHIFT; k++) {
+    int p = (int)(uint32_t)next_random(&state);
+    gain_t gain = {{0}, p, (int64_t)(1ULL << k), SAMPLE_STRIDE};
+
+    fixscale_init_pow2(&gain.scale, p, k);
+    ok = check(&gain, samples) && ok;
+  }
+  printf("%-6s sampled p/2^k for k = 0..%d\n", level, MAX_POW2_SHIFT);
+
+  printf("%-6s %s\n", level, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  bool quick = false;
+  unsigned random_gains = RANDOM_GAINS;
+  uint64_t samples = SAMPLES;
+  int opt = 0;
+
+  while ((opt = getopt(argc, argv, "qg:s:")) != -1) {
+    switch (opt) {
+    case 'q':
+      quick = true;
+      break;
+    case 'g':
+      random_gains = (unsigned)strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      samples = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-q] [-g random_gains] [-s samples]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (samples > (1ULL << 32)) {
+    samples = 1ULL << 32;
+  }
+
+  if (getenv("BITS_ISA") != NULL) {
+    return check_level(quick, random_gains, samples) ? 0 : 1;
+  }
+
+  // One child per level, each picking its kernels at startup
+  int status = 0;
+  for (int level = ISA_SCALAR; level <= (int)cpu_isa_level(); level++) {
+    pid_t child = fork();
+    if (child == 0) {
+      setenv("BITS_ISA", LEVEL_NAMES[level], 1);
+      execv("/proc/self/exe", argv);
+      perror("execv");
+      _exit(2);
+    }
+
+    int child_status = 0;
+    if (child < 0 || waitpid(child, &child_status, 0) < 0 ||
+        !WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0) {
+      status = 1;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,148 @@
+/*
+ * check_generic.c - Exhaustive check of the bits_generic.h primitives for
+ *                   the 8- and 16-bit types, signed and unsigned.
+ *
+ * Each input index packs two operands a and b of the type plus a parameter p
+ * that is the fits_bits n - 1, the mul_frac shift and the select_if condition.
+ * For the 8-bit types the index covers every a, b and p, so every call within
+ * the documented ranges is checked. For the 16-bit types it covers every pair
+ * a, b, with p hashed from the index. The references use int arithmetic, which
+ * is exact at these widths.
+ *
+ * Build: gcc -O3 -pthread -o check_generic check_generic.c exhaustive.c
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bits_generic.h"
+#include "exhaustive.h"
+
+enum {
+  SIGNED_IS_GREATER,
+  UNSIGNED_IS_GREATER,
+  SIGNED_FITS_BITS,
+  UNSIGNED_FITS_BITS,
+  SIGNED_SELECT_IF,
+  UNSIGNED_SELECT_IF,
+  SIGNED_MUL_FRAC,
+  UNSIGNED_MUL_FRAC,
+  SIGNED_IS_POW2,
+  UNSIGNED_IS_POW2,
+  PRIMITIVES
+};
+
+static const char *const PRIMITIVE_NAMES[PRIMITIVES] = {
+    "is_greater", "is_greater", "fits_bits", "fits_bits", "select_if",
+    "select_if",  "mul_frac",   "mul_frac",  "is_pow2",   "is_pow2",
+};
+
+// All p for the 8-bit types: 0 <= p < 8 in the bits above both operands
+#define PARAM_8(k) ((int)((k) >> 16))
+
+// 4 bits of a multiplicative hash of the index, so p varies with a and b
+#define PARAM_16(k) ((int)((uint32_t)((k) * 2654435761U) >> 28))
+
+// Sets bit id of failed when got and want differ
+#define FAILS(id, got, want) (failed |= (unsigned)((got) != (want)) << (id))
+
+/*
+ * DEFINE_WIDTH_CHECK(ssfx, usfx, T, U, param) - failures_##usfx, the set of
+ *     primitives (as bits of the enum above) that give a wrong result on
+ *     index k, and check_##usfx, its exhaustive_fn
+ */
+#define DEFINE_WIDTH_CHECK(ssfx, usfx, T, U, param)                            \
+  static inline unsigned failures_##usfx(uint32_t k) {                         \
+    const U ua = (U)k;                                                         \
+    const U ub = (U)(k >> BITS_WIDTH(U));                                      \
+    const T sa = (T)ua;                                                        \
+    const T sb = (T)ub;                                                        \
+    const int p = param(k);                                                    \
+    unsigned failed = 0;                                                       \
+                                                                               \
+    FAILS(SIGNED_IS_GREATER, is_greater_##ssfx(sa, sb), sa > sb);              \
+    FAILS(UNSIGNED_IS_GREATER, is_greater_##usfx(ua, ub), ua > ub);            \
+    FAILS(SIGNED_FITS_BITS, fits_bits_##ssfx(sa, p + 1),                       \
+          sa >= -(1 << p) && sa < (1 << p));                                   \
+    FAILS(UNSIGNED_FITS_BITS, fits_bits_##usfx(ua, p + 1), ua < (2 << p));     \
+    FAILS(SIGNED_SELECT_IF, select_if_##ssfx(p & 1, sa, sb),                   \
+          (p & 1) ? sa : sb);                                                  \
+    FAILS(UNSIGNED_SELECT_IF, select_if_##usfx(p & 1, ua, ub),                 \
+          (p & 1) ? ua : ub);                                                  \
+    FAILS(SIGNED_MUL_FRAC, mul_frac_##ssfx(sa, sb, p),                         \
+          (T)((T)(sa * sb) / (1 << p)));                                       \
+    FAILS(UNSIGNED_MUL_FRAC, mul_frac_##usfx(ua, ub, p),                       \
+          (U)((U)(1U * ua * ub) >> p));                                        \
+    FAILS(SIGNED_IS_POW2, is_pow2_##ssfx(sa), sa > 0 && (sa & (sa - 1)) == 0); \
+    FAILS(UNSIGNED_IS_POW2, is_pow2_##usfx(ua),                                \
+          ua != 0 && (ua & (ua - 1)) == 0);                                    \
+    return failed;                                                             \
+  }                                                                            \
+                                                                               \
+  static size_t check_##usfx(void *ctx, const int32_t *xs, const int32_t *ys,  \
+                             size_t n) {                                       \
+    unsigned failed = 0;                                                       \
+    (void)ctx;                                                                 \
+    (void)ys;                                                                  \
+    for (size_t i = 0; i < n; i++) {                                           \
+      failed |= failures_##usfx((uint32_t)xs[i]);                              \
+    }                                                                          \
+    if (failed == 0) {                                                         \
+      return n;                                                                \
+    }                                                                          \
+    for (size_t i = 0; i < n; i++) {                                           \
+      if (failures_##usfx((uint32_t)xs[i]) != 0) {                             \
+        return i;                                                              \
+      }                                                                        \
+    }                                                                          \
+    return n;                                                                  \
+  }
+
+DEFINE_WIDTH_CHECK(schar, uchar, signed char, unsigned char, PARAM_8)
+DEFINE_WIDTH_CHECK(short, ushort, short, unsigned short, PARAM_16)
+
+typedef struct {
+  const char *signed_name;
+  const char *unsigned_name;
+  int width;
+  uint64_t count; // indices to sweep
+  exhaustive_fn check;
+  unsigned (*failures)(uint32_t k);
+  int (*param)(uint32_t k);
+} width_t;
+
+static int param_8(uint32_t k) { return PARAM_8(k); }
+static int param_16(uint32_t k) { return PARAM_16(k); }
+
+static const width_t WIDTHS[] = {
+    {"schar", "uchar", 8, 1U << 19, check_uchar, failures_uchar, param_8},
+    {"short", "ushort", 16, 1ULL << 32, check_ushort, failures_ushort,
+     param_16},
+};
+
+int main(void) {
+  int status = 0;
+
+  for (size_t w = 0; w < sizeof(WIDTHS) / sizeof(*WIDTHS); w++) {
+    const width_t *width = &WIDTHS[w];
+    int32_t bad = 0;
+    int32_t unused = 0;
+
+    if (exhaustive_indices(width->check, NULL, width->count, &bad, &unused)) {
+      printf("%-6s %-6s ok\n", width->signed_name, width->unsigned_name);
+      continue;
+    }
+
+    uint32_t k = (uint32_t)bad;
+    unsigned failed = width->failures(k);
+    uint32_t mask = (1U << width->width) - 1U;
+    for (int i = 0; i < PRIMITIVES; i++) {
+      if (failed & (1U << i)) {
+        printf("%s_%s FAIL  a = 0x%x, b = 0x%x, p = %d\n", PRIMITIVE_NAMES[i],
+               (i % 2 == 0) ? width->signed_name : width->unsigned_name,
+               k & mask, (k >> width->width) & mask, width->param(k));
+      }
+    }
+    status = 1;
+  }
+  return status;
+}
@@ -0,0 +1,163 @@
+/*
+ * check_signconv.c - Exhaustive round-trip check of signconv.c.
+ *
+ * Every int goes through each conversion and back: two's complement to
+ * sign-magnitude and back (out of place and in place), zigzag encode and
+ * decode, and varint encode and decode. The forward results are compared with
+ * plain C references, varints byte count included, and the round trips must
+ * give back the input (0 for INT_MIN through sign-magnitude, which has no
+ * other form for it). Decoding each batch's varints with the last byte cut
+ * off must fail. A few malformed varints are checked once.
+ *
+ * The kernels are picked once at startup, so the checker runs itself again
+ * with BITS_ISA set to each level this CPU supports (see cpu_isa.h); setting
+ * BITS_ISA beforehand checks just that level.
+ *
+ * Build: gcc -O2 -pthread -o check_signconv check_signconv.c signconv.c
+ *            cpu_isa.c exhaustive.c
+ */
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cpu_isa.h"
+#include "exhaustive.h"
+#include "signconv.h"
+
+static const char *const LEVEL_NAMES[] = {"scalar", "sse2", "avx2", "avx512"};
+
+static int signmag_reference(int x) {
+  if (x >= 0) {
+    return x;
+  }
+  return (int)(0x80000000U | (0U - (unsigned)x));
+}
+
+static unsigned zigzag_reference(int x) {
+  return (x >= 0) ? 2U * (unsigned)x : 2U * (0U - (unsigned)x) - 1U;
+}
+
+static size_t varint_length(unsigned zigzag) {
+  size_t length = 1;
+  while (zigzag >= 0x80) {
+    zigzag >>= 7;
+    length++;
+  }
+  return length;
+}
+
+// exhaustive_fn: every conversion of x[0..n) and back
+static size_t check_batch(void *ctx, const int32_t *x, const int32_t *ys,
+                          size_t n) {
+  int signmag[EXHAUSTIVE_BATCH];
+  int twos[EXHAUSTIVE_BATCH];
+  int in_place[EXHAUSTIVE_BATCH];
+  unsigned zigzag[EXHAUSTIVE_BATCH];
+  int unzigzag[EXHAUSTIVE_BATCH];
+  int decoded[EXHAUSTIVE_BATCH];
+  uint8_t varints[VARINT_BOUND(EXHAUSTIVE_BATCH)];
+  size_t want_bytes = 0;
+
+  (void)ctx;
+  (void)ys;
+  twos_to_signmag_n(x, signmag, n);
+  signmag_to_twos_n(signmag, twos, n);
+  memcpy(in_place, x, n * sizeof(int));
+  twos_to_signmag_n(in_place, in_place, n);
+  signmag_to_twos_n(in_place, in_place, n);
+  zigzag_encode_n(x, zigzag, n);
+  zigzag_decode_n(zigzag, unzigzag, n);
+
+  for (size_t i = 0; i < n; i++) {
+    int round_trip = (x[i] == INT_MIN) ? 0 : x[i];
+
+    if (signmag[i] != signmag_reference(x[i]) || twos[i] != round_trip ||
+        in_place[i] != round_trip || zigzag[i] != zigzag_reference(x[i]) ||
+        unzigzag[i] != x[i]) {
+      return i;
+    }
+    want_bytes += varint_length(zigzag[i]);
+  }
+
+  // On a varint error, redo the values one at a time to find the culprit; if
+  // none fails alone, blame the first
+  size_t bytes = varint_encode_n(x, n, varints);
+  if (bytes != want_bytes ||
+      varint_decode_n(varints, bytes, decoded, n) != bytes ||
+      memcmp(decoded, x, n * sizeof(int)) != 0 ||
+      (n > 0 && varint_decode_n(varints, bytes - 1, decoded, n) != 0)) {
+    for (size_t i = 0; i < n; i++) {
+      bytes = varint_encode_n(&x[i], 1, varints);
+      if (bytes != varint_length(zigzag[i]) ||
+          varint_decode_n(varints, bytes, decoded, 1) != bytes ||
+          decoded[0] != x[i] ||
+          varint_decode_n(varints, bytes - 1, decoded, 1) != 0) {
+        return i;
+      }
+    }
+    return 0;
+  }
+  return n;
+}
+
+// Malformed varints must be rejected and the widest valid one accepted
+static bool check_malformed(void) {
+  static const uint8_t too_long[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x01};
+  static const uint8_t too_wide[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x1F};
+  static const uint8_t widest[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x0F};
+  int value = 0;
+
+  return varint_decode_n(too_long, sizeof(too_long), &value, 1) == 0 &&
+         varint_decode_n(too_wide, sizeof(too_wide), &value, 1) == 0 &&
+         varint_decode_n(widest, sizeof(widest), &value, 1) == 5 &&
+         value == INT_MIN;
+}
+
+// Checks all inputs at the current ISA level. Returns true if they pass.
+static bool check_level(void) {
+  const char *level = LEVEL_NAMES[cpu_isa_level()];
+  int32_t bad = 0;
+  int32_t unused = 0;
+
+  if (!check_malformed()) {
+    printf("%-6s FAIL  malformed varints\n", level);
+    return false;
+  }
+  if (!exhaustive_unary(check_batch, NULL, &bad, &unused)) {
+    printf("%-6s FAIL  x = %d (0x%08x)\n", level, bad, (unsigned)bad);
+    return false;
+  }
+  printf("%-6s ok  all 2^32 inputs\n", level);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  (void)argc;
+
+  if (getenv("BITS_ISA") != NULL) {
+    return check_level() ? 0 : 1;
+  }
+
+  // One child per level, each picking its kernels at startup
+  int status = 0;
+  for (int level = ISA_SCALAR; level <= (int)cpu_isa_level(); level++) {
+    pid_t child = fork();
+    if (child == 0) {
+      setenv("BITS_ISA", LEVEL_NAMES[level], 1);
+      execv("/proc/self/exe", argv);
+      perror("execv");
+      _exit(2);
+    }
+
+    int child_status = 0;
+    if (child < 0 || waitpid(child, &child_status, 0) < 0 ||
+        !WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0) {
+      status = 1;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,105 @@
+/*
+ * check_sortnet.c - Check sortnet_sort and sortnet_small against qsort.
+ *
+ * Every n from 0 to MAX_N is sorted for several inputs: random values, values
+ * from a narrow range (many ties), values at both extremes (where INT_MAX
+ * padding and sign handling go wrong), and sorted and reversed runs. The
+ * result must equal the qsort result element for element.
+ *
+ * Build: gcc -O2 -o check_sortnet check_sortnet.c sortnet.c cpu_isa.c
+ */
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sortnet.h"
+
+#define MAX_N 300 /* largest array checked */
+#define TRIALS 8  /* random inputs per kind and n */
+
+enum input_kind { RANDOM, TIES, EXTREMES, SORTED, REVERSED, INPUT_KINDS };
+
+static const char *const INPUT_NAMES[INPUT_KINDS] = {
+    "random", "ties", "extremes", "sorted", "reversed"};
+
+// xorshift64*, so failures reproduce
+static uint64_t next_random(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static void fill(int *a, size_t n, enum input_kind kind, uint64_t *state) {
+  for (size_t i = 0; i < n; i++) {
+    uint32_t r = (uint32_t)(next_random(state) >> 32);
+
+    switch (kind) {
+    case RANDOM:
+      a[i] = (int)r;
+      break;
+    case TIES:
+      a[i] = (int)(r % 7) - 3;
+      break;
+    case EXTREMES:
+      // INT_MIN, INT_MIN + 1, INT_MAX - 1 or INT_MAX
+      a[i] = (int)(r >> 1 & 1);
+      a[i] = (r & 1) ? INT_MAX - a[i] : INT_MIN + a[i];
+      break;
+    case SORTED:
+      a[i] = (int)i - (int)n / 2;
+      break;
+    default:
+      a[i] = (int)n / 2 - (int)i;
+      break;
+    }
+  }
+}
+
+static int compare_ints(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+int main(void) {
+  static int input[MAX_N];
+  static int want[MAX_N];
+  static int got[MAX_N];
+  uint64_t state = 1;
+  size_t checked = 0;
+
+  for (size_t n = 0; n <= MAX_N; n++) {
+    for (int kind = 0; kind < INPUT_KINDS; kind++) {
+      int trials = (kind == SORTED || kind == REVERSED) ? 1 : TRIALS;
+
+      for (int trial = 0; trial < trials; trial++) {
+        fill(input, n, kind, &state);
+        memcpy(want, input, n * sizeof(int));
+        qsort(want, n, sizeof(int), compare_ints);
+
+        memcpy(got, input, n * sizeof(int));
+        if (sortnet_sort(got, n) != 0 ||
+            memcmp(got, want, n * sizeof(int)) != 0) {
+          printf("sortnet_sort FAIL  n = %zu, %s input\n", n,
+                 INPUT_NAMES[kind]);
+          return 1;
+        }
+        if (n <= SORTNET_MAX) {
+          memcpy(got, input, n * sizeof(int));
+          sortnet_small(got, n);
+          if (memcmp(got, want, n * sizeof(int)) != 0) {
+            printf("sortnet_small FAIL  n = %zu, %s input\n", n,
+                   INPUT_NAMES[kind]);
+            return 1;
+          }
+        }
+        checked++;
+      }
+    }
+  }
+  printf("ok  %zu arrays, n = 0..%d\n", checked, MAX_N);
+  return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * cpu_isa.c - Runtime detection of the x86 vector extensions the batch kernels
+ *             can use.
+ */
+#include "cpu_isa.h"
+#include <stdlib.h>
+#include <string.h>
+
+static enum isa_level detect(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  // AVX-512 kernels also use byte and word lanes, so BW is required too
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return ISA_AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return ISA_AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return ISA_SSE2;
+  }
+#endif
+  return ISA_SCALAR;
+}
+
+static enum isa_level env_cap(void) {
+  const char *names[] = {"scalar", "sse2", "avx2", "avx512"};
+  const char *cap = getenv("BITS_ISA");
+
+  if (cap != NULL) {
+    for (int level = ISA_SCALAR; level <= ISA_AVX512; level++) {
+      if (strcmp(cap, names[level]) == 0) {
+        return (enum isa_level)level;
+      }
+    }
+  }
+  return ISA_AVX512;
+}
+
+enum isa_level cpu_isa_level(void) {
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+  static int level = -1;
+
+  if (level < 0) {
+    enum isa_level detected = detect();
+    enum isa_level cap = env_cap();
+    level = (detected < cap) ? detected : cap;
+  }
+  return (enum isa_level)level;
+}
+
+// env_cap knows no level by this name, so it leaves the level at avx512
+static const char NOHW_NAME[] = "avx512-nohw";
+
+bool cpu_isa_extras(void) {
+  const char *cap = getenv("BITS_ISA");
+  return cap == NULL || strcmp(cap, NOHW_NAME) != 0;
+}
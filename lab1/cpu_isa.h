@@ -0,0 +1,25 @@
+/*
+ * cpu_isa.h - Runtime detection of the x86 vector extensions the batch kernels
+ *             can use.
+ */
+#ifndef CPU_ISA_H
+#define CPU_ISA_H
+
+#include <stdbool.h>
+
+// Ordered, so a kernel written for one level runs on every higher level
+enum isa_level { ISA_SCALAR, ISA_SSE2, ISA_AVX2, ISA_AVX512 };
+
+// Best level supported by this CPU (checked once through CPUID). Setting the
+// BITS_ISA environment variable to scalar, sse2, avx2 or avx512 caps the
+// result, which is how the benchmarks compare implementations. avx512-nohw
+// caps it at avx512 and also turns off cpu_isa_extras.
+enum isa_level cpu_isa_level(void);
+
+// Whether AVX-512 kernels may use the optional extensions (AVX512CD,
+// AVX512_VPOPCNTDQ) where the CPU has them. False under BITS_ISA=avx512-nohw,
+// so the kernels written without them still get checked and timed on CPUs
+// that have them.
+bool cpu_isa_extras(void);
+
+#endif
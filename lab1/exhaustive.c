@@ -0,0 +1,211 @@
+/*
+ * exhaustive.c - Parallel input generation and checking for exhaustive.h.
+ *
+ * Inputs are numbered, and each number maps to one input, so any range of
+ * them can be generated independently. Threads take chunks of CHUNK inputs
+ * in order from a shared counter. When a chunk fails, no new chunks are
+ * handed out, but the chunks already taken (all of them earlier ones) are
+ * finished, so the earliest failure overall is always found.
+ */
+#include "exhaustive.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHUNK (1U << 16) /* inputs per unit of work */
+
+typedef struct {
+  exhaustive_fn check;
+  void *ctx;
+  uint64_t total;            // number of inputs
+  atomic_uint_fast64_t next; // first input of the next chunk to hand out
+  atomic_bool failed;        // stop handing out chunks
+  pthread_mutex_t lock;      // guards first_bad
+  uint64_t first_bad;        // number of the earliest failing input, or total
+
+  // Binary inputs only
+  int32_t edges[EXHAUSTIVE_EDGES];
+  uint64_t edge_count;
+} sweep_t;
+
+size_t exhaustive_edge_values(int32_t *out) {
+  size_t count = 0;
+  const int small = 16;
+
+  for (int i = -small; i <= small; i++) {
+    out[count++] = i;
+  }
+  for (int bit = 5; bit < 32; bit++) {
+    uint32_t power = 1U << bit;
+    for (int delta = -1; delta <= 1; delta++) {
+      out[count++] = (int32_t)(power + (uint32_t)delta);
+      out[count++] = (int32_t)(0U - power + (uint32_t)delta);
+    }
+  }
+  out[count++] = INT32_MAX;
+  out[count++] = INT32_MAX - 1;
+  return count;
+}
+
+// splitmix64 of the input number, so random pairs need no shared state
+static uint64_t mix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Writes binary inputs first .. first + n - 1: edge pairs, dense square, then
+// random pairs
+static void binary_inputs(const sweep_t *sweep, uint64_t first, int32_t *xs,
+                          int32_t *ys, size_t n) {
+  const uint64_t edge_pairs = sweep->edge_count * sweep->edge_count;
+  const uint64_t dense_pairs = (uint64_t)EXHAUSTIVE_DENSE * EXHAUSTIVE_DENSE;
+
+  for (size_t i = 0; i < n; i++) {
+    uint64_t k = first + i;
+
+    if (k < edge_pairs) {
+      xs[i] = sweep->edges[k / sweep->edge_count];
+      ys[i] = sweep->edges[k % sweep->edge_count];
+    } else if (k < edge_pairs + dense_pairs) {
+      k -= edge_pairs;
+      xs[i] = (int32_t)(k / EXHAUSTIVE_DENSE) - EXHAUSTIVE_DENSE / 2;
+      ys[i] = (int32_t)(k % EXHAUSTIVE_DENSE) - EXHAUSTIVE_DENSE / 2;
+    } else {
+      uint64_t r = mix(k);
+      xs[i] = (int32_t)(uint32_t)r;
+      ys[i] = (k & 1) ? (int32_t)(uint32_t)(r >> 32)
+                      : (int32_t)((uint32_t)xs[i] + ((r >> 32) & 7) - 3);
+    }
+  }
+}
+
+// Thread body: check chunks until the inputs run out or one fails
+static void *run_sweep(void *arg) {
+  sweep_t *sweep = arg;
+  int32_t xs[EXHAUSTIVE_BATCH];
+  int32_t ys[EXHAUSTIVE_BATCH];
+  const bool unary = sweep->edge_count == 0;
+
+  memset(ys, 0, sizeof(ys));
+  while (!atomic_load(&sweep->failed)) {
+    uint64_t begin = atomic_fetch_add(&sweep->next, CHUNK);
+    if (begin >= sweep->total) {
+      break;
+    }
+    uint64_t end =
+        (sweep->total - begin < CHUNK) ? sweep->total : begin + CHUNK;
+
+    for (uint64_t first = begin; first < end; first += EXHAUSTIVE_BATCH) {
+      size_t n = (end - first < EXHAUSTIVE_BATCH) ? (size_t)(end - first)
+                                                  : EXHAUSTIVE_BATCH;
+      if (unary) {
+        for (size_t i = 0; i < n; i++) {
+          xs[i] = (int32_t)(uint32_t)(first + i);
+        }
+      } else {
+        binary_inputs(sweep, first, xs, ys, n);
+      }
+
+      size_t bad = sweep->check(sweep->ctx, xs, ys, n);
+      if (bad < n) {
+        pthread_mutex_lock(&sweep->lock);
+        if (first + bad < sweep->first_bad) {
+          sweep->first_bad = first + bad;
+        }
+        pthread_mutex_unlock(&sweep->lock);
+        atomic_store(&sweep->failed, true);
+        break;
+      }
+    }
+  }
+  return NULL;
+}
+
+static size_t thread_count(void) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *cap = getenv("EXHAUSTIVE_THREADS");
+  size_t threads = (cores > 0) ? (size_t)cores : 1;
+
+  if (cap != NULL && atol(cap) > 0 && (size_t)atol(cap) < threads) {
+    threads = (size_t)atol(cap);
+  }
+  return threads;
+}
+
+/*
+ * run - Check every input of the sweep on all threads, and recover the
+ *     earliest failing one
+ */
+static bool run(sweep_t *sweep, int32_t *bad_x, int32_t *bad_y) {
+  size_t threads = thread_count();
+  pthread_t *ids = calloc(threads, sizeof(*ids));
+
+  atomic_init(&sweep->next, 0);
+  atomic_init(&sweep->failed, false);
+  pthread_mutex_init(&sweep->lock, NULL);
+  sweep->first_bad = sweep->total;
+
+  for (size_t t = 1; t < threads; t++) {
+    if (pthread_create(&ids[t], NULL, run_sweep, sweep) != 0) {
+      threads = t;
+      break;
+    }
+  }
+  run_sweep(sweep);
+  for (size_t t = 1; t < threads; t++) {
+    pthread_join(ids[t], NULL);
+  }
+  free(ids);
+  pthread_mutex_destroy(&sweep->lock);
+
+  if (sweep->first_bad == sweep->total) {
+    return true;
+  }
+
+  int32_t x = 0;
+  int32_t y = 0;
+  if (sweep->edge_count == 0) {
+    x = (int32_t)(uint32_t)sweep->first_bad;
+  } else {
+    binary_inputs(sweep, sweep->first_bad, &x, &y, 1);
+  }
+  *bad_x = x;
+  *bad_y = y;
+  return false;
+}
+
+bool exhaustive_unary(exhaustive_fn check, void *ctx, int32_t *bad_x,
+                      int32_t *bad_y) {
+  return exhaustive_indices(check, ctx, 1ULL << 32, bad_x, bad_y);
+}
+
+bool exhaustive_indices(exhaustive_fn check, void *ctx, uint64_t count,
+                        int32_t *bad_x, int32_t *bad_y) {
+  sweep_t *sweep = calloc(1, sizeof(*sweep));
+
+  sweep->check = check;
+  sweep->ctx = ctx;
+  sweep->total = count;
+  bool ok = run(sweep, bad_x, bad_y);
+  free(sweep);
+  return ok;
+}
+
+bool exhaustive_binary(exhaustive_fn check, void *ctx, uint64_t random_pairs,
+                       int32_t *bad_x, int32_t *bad_y) {
+  sweep_t *sweep = calloc(1, sizeof(*sweep));
+
+  sweep->check = check;
+  sweep->ctx = ctx;
+  sweep->edge_count = exhaustive_edge_values(sweep->edges);
+  sweep->total = sweep->edge_count * sweep->edge_count +
+                 (uint64_t)EXHAUSTIVE_DENSE * EXHAUSTIVE_DENSE + random_pairs;
+  bool ok = run(sweep, bad_x, bad_y);
+  free(sweep);
+  return ok;
+}
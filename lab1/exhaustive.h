@@ -0,0 +1,56 @@
+/*
+ * exhaustive.h - Parallel checking of 32-bit integer functions against a
+ *                reference, over every input or a dense sample of pairs.
+ *
+ * The engine only generates inputs and spreads them over all cores; what is
+ * checked is up to a callback that gets them in batches:
+ *
+ *   size_t check(void *ctx, const int32_t *x, const int32_t *y, size_t n)
+ *
+ * It evaluates both sides on x[0..n) (and y[0..n)) and returns the index of
+ * the first mismatch, or n if there is none. Working on whole arrays lets the
+ * compiler vectorize both sides, and the mismatch scan as well. Callbacks run
+ * on several threads at once, so ctx must be read-only.
+ *
+ *   exhaustive_unary   every x from INT32_MIN to INT32_MAX, with y = 0
+ *   exhaustive_indices every x from 0 to count - 1 (count <= 2^32), with
+ *                      y = 0, for callers that decode their own inputs
+ *                      from an index
+ *   exhaustive_binary  every pair of edge values (small numbers, the extremes,
+ *                      and the neighbourhood of every power of two and its
+ *                      negation), every pair in
+ *                      [-EXHAUSTIVE_DENSE / 2, EXHAUSTIVE_DENSE / 2)^2, then
+ *                      random_pairs pseudo-random pairs, half of them within
+ *                      3 of each other
+ *
+ * All return true when every input passes. Otherwise they store the failing
+ * input that comes first in the order above in *bad_x and *bad_y, which makes
+ * the result the same however many threads ran. EXHAUSTIVE_THREADS in the
+ * environment caps the number of threads, which defaults to one per core.
+ */
+#ifndef EXHAUSTIVE_H
+#define EXHAUSTIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EXHAUSTIVE_BATCH 1024 /* most inputs passed to one check call */
+#define EXHAUSTIVE_DENSE 1024 /* side of the dense square of binary pairs */
+#define EXHAUSTIVE_EDGES 256  /* room needed by exhaustive_edge_values */
+
+typedef size_t (*exhaustive_fn)(void *ctx, const int32_t *x, const int32_t *y,
+                                size_t n);
+
+bool exhaustive_unary(exhaustive_fn check, void *ctx, int32_t *bad_x,
+                      int32_t *bad_y);
+bool exhaustive_indices(exhaustive_fn check, void *ctx, uint64_t count,
+                        int32_t *bad_x, int32_t *bad_y);
+bool exhaustive_binary(exhaustive_fn check, void *ctx, uint64_t random_pairs,
+                       int32_t *bad_x, int32_t *bad_y);
+
+// The edge values used by exhaustive_binary, at most EXHAUSTIVE_EDGES of them.
+// Returns how many were written.
+size_t exhaustive_edge_values(int32_t *out);
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * fixscale.c - Division-free rational scaling, with AVX2 and AVX-512 batch
+ *              kernels chosen at startup.
+ *
+ * With a = |x| and d = |q|, split |p| = W * d + R. The magnitude of the
+ * result is
+ *
+ *   a * |p| / d = a * W + a * R / d,  and  a * R / d = (a * F) >> 64
+ *
+ * for F = ceil(2^64 * R / d), the reciprocal of d scaled by R. F overshoots
+ * R / d by less than 2^-64, so a * F overshoots a * R / d by less than
+ * a / 2^64 <= 2^-33, while the fractional part of a * R / d is at most
+ * 1 - 1/d with d <= 2^31: the floor cannot change. (Power-of-2 divisors up to
+ * 2^62 give an exact F.) Both products fit in 64 bits once a < 2^32, so the
+ * division costs one multiply and one multiply-high.
+ *
+ * Dividing magnitudes and then restoring the sign rounds toward zero, which is
+ * the fixup multFiveEighths does by shifting first and then adding 1 when
+ * x * 5 is negative and the shift dropped a remainder.
+ */
+#include "fixscale.h"
+
+#include <limits.h>
+
+#include "cpu_isa.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIXSCALE_X86
+#include <immintrin.h>
+#endif
+
+#define MAX_POW2_SHIFT 62 /* largest k for fixscale_init_pow2 */
+
+typedef size_t (*scale_kernel)(const fixscale_t *scale, const int *x, int *out,
+                               size_t n, int saturate);
+
+// High 64 bits of a * b, for a < 2^32
+static inline uint64_t mulhi64_u32(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  return (uint64_t)(((unsigned __int128)a * b) >> 64);
+#else
+  return (a * (b >> 32) + ((a * (b & UINT32_MAX)) >> 32)) >> 32;
+#endif
+}
+
+static void set_gain(fixscale_t *scale, uint64_t magnitude, uint64_t divisor,
+                     int negative) {
+  // F = ceil(2^64 * R / d), by long division of R followed by 64 zero bits.
+  // The remainder stays below d <= 2^62, so shifting it never overflows.
+  uint64_t remainder = magnitude % divisor;
+  uint64_t fraction = 0;
+  for (int bit = 0; bit < 64; bit++) {
+    remainder <<= 1;
+    fraction <<= 1;
+    if (remainder >= divisor) {
+      remainder -= divisor;
+      fraction |= 1;
+    }
+  }
+
+  scale->whole = magnitude / divisor;
+  scale->fraction = fraction + (remainder != 0);
+  scale->sign_mask = negative ? UINT64_MAX : 0;
+}
+
+int fixscale_init(fixscale_t *scale, int p, int q) {
+  if (q == 0) {
+    return -1;
+  }
+
+  uint64_t p_magnitude = (p < 0) ? -(uint64_t)(int64_t)p : (uint64_t)p;
+  uint64_t q_magnitude = (q < 0) ? -(uint64_t)(int64_t)q : (uint64_t)q;
+  set_gain(scale, p_magnitude, q_magnitude, (p < 0) != (q < 0));
+  return 0;
+}
+
+int fixscale_init_pow2(fixscale_t *scale, int p, int k) {
+  if (k < 0 || k > MAX_POW2_SHIFT) {
+    return -1;
+  }
+
+  uint64_t p_magnitude = (p < 0) ? -(uint64_t)(int64_t)p : (uint64_t)p;
+  set_gain(scale, p_magnitude, (uint64_t)1 << k, p < 0);
+  return 0;
+}
+
+int64_t fixscale_wide(const fixscale_t *scale, int x) {
+  uint64_t x_sign_mask = (uint64_t)-(int64_t)(x < 0);
+  uint64_t magnitude = ((uint64_t)(int64_t)x ^ x_sign_mask) - x_sign_mask;
+  uint64_t quotient =
+      magnitude * scale->whole + mulhi64_u32(magnitude, scale->fraction);
+  uint64_t sign_mask = x_sign_mask ^ scale->sign_mask;
+  return (int64_t)((quotient ^ sign_mask) - sign_mask);
+}
+
+int fixscale(const fixscale_t *scale, int x) {
+  return (int)fixscale_wide(scale, x);
+}
+
+// As in fitsBits: a value fits in 32 bits iff bits 31 and up are all copies of
+// the sign, i.e. wide >> 31 is 0 or -1
+int fixscale_checked(const fixscale_t *scale, int x, int *out) {
+  int64_t wide = fixscale_wide(scale, x);
+  *out = (int)wide;
+  return ((uint64_t)(wide >> 31) + 1 <= 1) ? 0 : -1;
+}
+
+static size_t scale_scalar(const fixscale_t *scale, const int *x, int *out,
+                           size_t n, int saturate) {
+  size_t clamped = 0;
+  for (size_t i = 0; i < n; i++) {
+    int64_t wide = fixscale_wide(scale, x[i]);
+    if (saturate && (wide > INT_MAX || wide < INT_MIN)) {
+      wide = (wide > 0) ? INT_MAX : INT_MIN;
+      clamped++;
+    }
+    out[i] = (int)wide;
+  }
+  return clamped;
+}
+
+#ifdef FIXSCALE_X86
+
+/*
+ * DEFINE_KERNEL(isa, isa_target, bytes, mul_epu32, ivec) - batch kernel for
+ *     one instruction set, with bytes-wide vectors of 64-bit lanes.
+ *
+ * x86 has no vector 64-bit multiply, but it does multiply the low 32 bits of
+ * each 64-bit lane into a full 64-bit product (mul_epu32 on the intrinsic type
+ * ivec). Since |x| < 2^32, a * W is one such product and (a * F) >> 64 is two.
+ *
+ * Clamping uses comparison masks the way conditional does, and the masks (-1
+ * per clamped lane) are summed to count the clamped elements.
+ *
+ * There is no SSE2 kernel: two 64-bit lanes without SSE4's 64-bit compare and
+ * sign extension run several times slower than the scalar loop, which gets a
+ * full 64x64-bit multiply-high in one instruction.
+ */
+#define DEFINE_KERNEL(isa, isa_target, bytes, mul_epu32, ivec)                 \
+  typedef int64_t wide_##isa __attribute__((vector_size(bytes)));              \
+  typedef uint64_t uwide_##isa __attribute__((vector_size(bytes)));            \
+  typedef int narrow_##isa                                                     \
+      __attribute__((vector_size((bytes) / 2), aligned(4)));                   \
+  typedef unsigned unarrow_##isa __attribute__((vector_size((bytes) / 2)));    \
+                                                                               \
+  __attribute__((target(isa_target))) static inline uwide_##isa                \
+      mul_lo32_##isa(uwide_##isa a, uwide_##isa b) {                           \
+    return (uwide_##isa)mul_epu32((ivec)a, (ivec)b);                           \
+  }                                                                            \
+                                                                               \
+  __attribute__((target(isa_target))) static size_t scale_##isa(               \
+      const fixscale_t *scale, const int *x, int *out, size_t n,               \
+      int saturate) {                                                          \
+    const size_t lanes = (bytes) / sizeof(int64_t);                            \
+    const uwide_##isa whole = (uwide_##isa){0} + scale->whole;                 \
+    const uwide_##isa fraction_lo = (uwide_##isa){0} + scale->fraction;        \
+    const uwide_##isa fraction_hi = fraction_lo >> 32;                         \
+    wide_##isa clamped = {0};                                                  \
+    size_t i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                       \
+      narrow_##isa vx = *(const narrow_##isa *)(x + i);                        \
+      narrow_##isa x_sign = vx >> 31;                                          \
+      unarrow_##isa x_magnitude =                                              \
+          ((unarrow_##isa)vx ^ (unarrow_##isa)x_sign) - (unarrow_##isa)x_sign; \
+      uwide_##isa magnitude =                                                  \
+          __builtin_convertvector(x_magnitude, uwide_##isa);                   \
+      uwide_##isa sign_mask =                                                  \
+          (uwide_##isa)__builtin_convertvector(x_sign, wide_##isa) ^           \
+          scale->sign_mask;                                                    \
+      uwide_##isa fraction_part =                                              \
+          (mul_lo32_##isa(magnitude, fraction_hi) +                            \
+           (mul_lo32_##isa(magnitude, fraction_lo) >> 32)) >>                  \
+          32;                                                                  \
+      uwide_##isa quotient =                                                   \
+          mul_lo32_##isa(magnitude, whole) + fraction_part;                    \
+      wide_##isa wide = (wide_##isa)((quotient ^ sign_mask) - sign_mask);      \
+      if (saturate) {                                                          \
+        wide_##isa too_high = wide > INT_MAX;                                  \
+        wide_##isa too_low = wide < INT_MIN;                                   \
+        wide = (wide & ~(too_high | too_low)) | (too_high & INT_MAX) |         \
+               (too_low & INT_MIN);                                            \
+        clamped += too_high + too_low;                                         \
+      }                                                                        \
+      *(narrow_##isa *)(out + i) =                                             \
+          __builtin_convertvector(wide, narrow_##isa);                         \
+    }                                                                          \
+                                                                               \
+    size_t total = scale_scalar(scale, x + i, out + i, n - i, saturate);       \
+    for (size_t lane = 0; lane < lanes; lane++) {                              \
+      total -= (size_t)clamped[lane];                                          \
+    }                                                                          \
+    return total;                                                              \
+  }
+
+DEFINE_KERNEL(avx2, "avx2", 32, _mm256_mul_epu32, __m256i)
+DEFINE_KERNEL(avx512, "avx512f,avx512bw", 64, _mm512_mul_epu32, __m512i)
+
+#endif
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static scale_kernel active_kernel = scale_scalar;
+
+__attribute__((constructor)) static void select_kernel(void) {
+  switch (cpu_isa_level()) {
+#ifdef FIXSCALE_X86
+  case ISA_AVX512:
+    active_kernel = scale_avx512;
+    break;
+  case ISA_AVX2:
+    active_kernel = scale_avx2;
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+void fixscale_n(const fixscale_t *scale, const int *x, int *out, size_t n) {
+  active_kernel(scale, x, out, n, 0);
+}
+
+size_t fixscale_sat_n(const fixscale_t *scale, const int *x, int *out,
+                      size_t n) {
+  return active_kernel(scale, x, out, n, 1);
+}
@@ -0,0 +1,47 @@
+/*
+ * fixscale.h - Multiplying ints by a rational gain p/q with the rounding of
+ *              C division, without dividing per element.
+ *
+ * fixscale(&scale, x) equals (int64_t)x * p / q, the way multFiveEighths
+ * equals x * 5 / 8: the exact product is divided rounding toward zero. The
+ * division is replaced by multiplications with a precomputed reciprocal, so
+ * fixscale_init does the only real division. p/2^k gains can go beyond q's
+ * int range through fixscale_init_pow2.
+ */
+#ifndef FIXSCALE_H
+#define FIXSCALE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  uint64_t whole;     /* |p| / |q| */
+  uint64_t fraction;  /* ceil(2^64 * (|p| % |q|) / |q|) */
+  uint64_t sign_mask; /* all ones if p and q have opposite signs */
+} fixscale_t;
+
+// Gain p/q. Returns 0, or -1 if q is 0.
+int fixscale_init(fixscale_t *scale, int p, int q);
+
+// Gain p/2^k, 0 <= k <= 62. Returns 0, or -1 if k is out of range.
+int fixscale_init_pow2(fixscale_t *scale, int p, int k);
+
+// (int64_t)x * p / q exactly; |result| <= 2^62, so this never overflows
+int64_t fixscale_wide(const fixscale_t *scale, int x);
+
+// The result truncated to int, like casting the C expression
+int fixscale(const fixscale_t *scale, int x);
+
+// Stores the result and returns 0 if it fits in an int; otherwise stores the
+// truncated result and returns -1
+int fixscale_checked(const fixscale_t *scale, int x, int *out);
+
+// fixscale for n elements. out may alias x.
+void fixscale_n(const fixscale_t *scale, const int *x, int *out, size_t n);
+
+// Like fixscale_n, but results outside the int range are clamped to INT_MIN
+// or INT_MAX. Returns the number of elements clamped.
+size_t fixscale_sat_n(const fixscale_t *scale, const int *x, int *out,
+                      size_t n);
+
+#endif
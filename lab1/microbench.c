@@ -0,0 +1,288 @@
+/*
+ * microbench.c - Cycle-level microbenchmarks for the bits.c functions against
+ *                what the compiler generates for the plain C expression.
+ *
+ * Every function is measured two ways:
+ *
+ *   latency     one long dependent chain: each call's input is XORed with the
+ *               previous result, so calls cannot overlap
+ *   throughput  independent calls over arrays, so the CPU (and the compiler's
+ *               vectorizer) can overlap as much as they like
+ *
+ * The array functions of bits_vec.h get a third row, "vec" (and "vec_mask" for
+ * the mask variants), timed over the same arrays in one call per pass, so it
+ * has a throughput figure only. Throughput rows also give elements_per_cycle,
+ * the reciprocal of cycles.
+ *
+ * bits.c is included directly so its functions can be inlined exactly like the
+ * naive expressions. Cycles come from perf_event_open when the kernel allows
+ * it (core cycles) and from rdtsc otherwise (reference cycles); the counter
+ * column says which. The "chain" baseline rows are the cost of the loops alone
+ * (load, XOR, store), and net_cycles subtracts them from each result.
+ *
+ * Results are printed as CSV, one row per function, implementation and mode,
+ * tagged with the compiler version and BUILD_FLAGS, so runs with different
+ * compilers and -O levels can be concatenated and compared.
+ *
+ * Build: gcc -O2 -DBUILD_FLAGS='"-O2"' -o microbench microbench.c bits_vec.c
+ *            cpu_isa.c
+ */
+#include <limits.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include "bits.c"
+#include "bits_vec.h"
+
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS "unknown"
+#endif
+
+#define ARRAY_LEN 4096 /* inputs per throughput pass (fits in L1) */
+#define CHAIN_LEN (1 << 20) /* calls per latency run */
+#define PASSES 256          /* throughput passes per run */
+#define RUNS 7              /* repetitions; the fastest run is reported */
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+static int in_a[ARRAY_LEN];
+static int in_b[ARRAY_LEN];
+static int in_c[ARRAY_LEN];
+static int out[ARRAY_LEN];
+static volatile int sink;
+static int perf_fd = -1;
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+static void open_cycle_counter(void) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if (perf_fd >= 0) {
+    ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+static uint64_t cycles(void) {
+  uint64_t count = 0;
+
+  if (perf_fd >= 0 && read(perf_fd, &count, sizeof(count)) == sizeof(count)) {
+    return count;
+  }
+  _mm_lfence();
+  count = __rdtsc();
+  _mm_lfence();
+  return count;
+}
+
+/*
+ * DEFINE_BENCH(id, expr) - latency and throughput loops for one expression of
+ *     a, b and c. The loops are noinline so each one is compiled (and possibly
+ *     vectorized) on its own, with expr inlined into it.
+ */
+#define DEFINE_BENCH(id, expr)                                                 \
+  __attribute__((noinline)) static double id##_latency(void) {                 \
+    int acc = 0;                                                               \
+    uint64_t start = cycles();                                                 \
+    for (int i = 0; i < CHAIN_LEN; i++) {                                      \
+      int a = in_a[i & (ARRAY_LEN - 1)] ^ acc;                                 \
+      int b = in_b[i & (ARRAY_LEN - 1)];                                       \
+      int c = in_c[i & (ARRAY_LEN - 1)];                                       \
+      (void)b;                                                                 \
+      (void)c;                                                                 \
+      acc = (expr);                                                            \
+    }                                                                          \
+    uint64_t stop = cycles();                                                  \
+    sink = acc;                                                                \
+    return (double)(stop - start) / CHAIN_LEN;                                 \
+  }                                                                            \
+                                                                               \
+  __attribute__((noinline)) static double id##_throughput(void) {              \
+    uint64_t start = cycles();                                                 \
+    for (int pass = 0; pass < PASSES; pass++) {                                \
+      for (int i = 0; i < ARRAY_LEN; i++) {                                    \
+        int a = in_a[i];                                                       \
+        int b = in_b[i];                                                       \
+        int c = in_c[i];                                                       \
+        (void)b;                                                               \
+        (void)c;                                                               \
+        out[i] = (expr);                                                       \
+      }                                                                        \
+      __asm__ volatile("" : : "r"(out) : "memory");                            \
+    }                                                                          \
+    uint64_t stop = cycles();                                                  \
+    return (double)(stop - start) / ((double)PASSES * ARRAY_LEN);              \
+  }
+
+/*
+ * DEFINE_BATCH_BENCH(id, call) - throughput loop for a bits_vec.h function;
+ *     call is a call on the whole in_a, in_b and out arrays
+ */
+#define DEFINE_BATCH_BENCH(id, call)                                           \
+  __attribute__((noinline)) static double id##_throughput(void) {              \
+    uint64_t start = cycles();                                                 \
+    for (int pass = 0; pass < PASSES; pass++) {                                \
+      call;                                                                    \
+      __asm__ volatile("" : : "r"(out) : "memory");                            \
+    }                                                                          \
+    uint64_t stop = cycles();                                                  \
+    return (double)(stop - start) / ((double)PASSES * ARRAY_LEN);              \
+  }
+
+// fitsBits takes n in 1..32, derived from b so it varies per element. The
+// array version takes one width for all elements, so it is compared against
+// rows with n fixed at FITS_N_FIXED.
+#define FITS_N ((b & 31) + 1)
+#define FITS_N_FIXED 16
+
+DEFINE_BENCH(chain, a)
+DEFINE_BENCH(is_tmax_bits, isTmax(a))
+DEFINE_BENCH(is_tmax_naive, a == INT_MAX)
+DEFINE_BENCH(even_bits_bits, a ^ evenBits())
+DEFINE_BENCH(even_bits_naive, a ^ 0x55555555)
+DEFINE_BENCH(is_equal_bits, isEqual(a, b))
+DEFINE_BENCH(is_equal_naive, a == b)
+DEFINE_BENCH(fits_bits_bits, fitsBits(a, FITS_N))
+DEFINE_BENCH(fits_bits_naive,
+             (int64_t)a >= -(1LL << (FITS_N - 1)) &&
+                 (int64_t)a < (1LL << (FITS_N - 1)))
+DEFINE_BENCH(conditional_bits, conditional(a, b, c))
+DEFINE_BENCH(conditional_naive, a ? b : c)
+DEFINE_BENCH(is_greater_bits, isGreater(a, b))
+DEFINE_BENCH(is_greater_naive, a > b)
+DEFINE_BENCH(mult_five_eighths_bits, multFiveEighths(a))
+DEFINE_BENCH(mult_five_eighths_naive, (int)((unsigned)a * 5U) / 8)
+DEFINE_BENCH(logical_neg_bits, logicalNeg(a))
+DEFINE_BENCH(logical_neg_naive, !a)
+// twosComp2SignMag assumes x > Tmin; the input generator never produces Tmin
+DEFINE_BENCH(twos_comp_2_sign_mag_bits, twosComp2SignMag(a))
+DEFINE_BENCH(twos_comp_2_sign_mag_naive,
+             a < 0 ? (int)(0x80000000U | (0U - (unsigned)a)) : a)
+DEFINE_BENCH(is_power2_bits, isPower2(a))
+DEFINE_BENCH(is_power2_naive, a > 0 && (a & (a - 1)) == 0)
+DEFINE_BENCH(fits_bits_fixed_bits, fitsBits(a, FITS_N_FIXED))
+DEFINE_BENCH(fits_bits_fixed_naive, a >= -(1 << (FITS_N_FIXED - 1)) &&
+                                        a < (1 << (FITS_N_FIXED - 1)))
+
+#define N ARRAY_LEN
+DEFINE_BATCH_BENCH(is_equal_vec, isEqual_n(in_a, in_b, out, N))
+DEFINE_BATCH_BENCH(is_equal_vec_mask, isEqual_mask_n(in_a, in_b, out, N))
+DEFINE_BATCH_BENCH(fits_bits_fixed_vec, fitsBits_n(in_a, FITS_N_FIXED, out, N))
+DEFINE_BATCH_BENCH(fits_bits_fixed_vec_mask,
+                   fitsBits_mask_n(in_a, FITS_N_FIXED, out, N))
+DEFINE_BATCH_BENCH(is_greater_vec, isGreater_n(in_a, in_b, out, N))
+DEFINE_BATCH_BENCH(is_greater_vec_mask, isGreater_mask_n(in_a, in_b, out, N))
+DEFINE_BATCH_BENCH(logical_neg_vec, logicalNeg_n(in_a, out, N))
+DEFINE_BATCH_BENCH(logical_neg_vec_mask, logicalNeg_mask_n(in_a, out, N))
+DEFINE_BATCH_BENCH(is_power2_vec, isPower2_n(in_a, out, N))
+DEFINE_BATCH_BENCH(is_power2_vec_mask, isPower2_mask_n(in_a, out, N))
+#undef N
+
+typedef struct {
+  const char *function;
+  const char *impl;
+  double (*latency)(void); // NULL for the array functions
+  double (*throughput)(void);
+} bench_t;
+
+#define BENCH(function, id)                                                    \
+  {function, "bits", id##_bits_latency, id##_bits_throughput},                 \
+      {function, "naive", id##_naive_latency, id##_naive_throughput }
+
+#define BENCH_VEC(function, id)                                                \
+  BENCH(function, id), {function, "vec", NULL, id##_vec_throughput},           \
+      {function, "vec_mask", NULL, id##_vec_mask_throughput }
+
+static const bench_t BENCHES[] = {
+    {"chain", "baseline", chain_latency, chain_throughput},
+    BENCH("isTmax", is_tmax),
+    BENCH("evenBits", even_bits),
+    BENCH_VEC("isEqual", is_equal),
+    BENCH("fitsBits", fits_bits),
+    BENCH_VEC("fitsBits(n=16)", fits_bits_fixed),
+    BENCH("conditional", conditional),
+    BENCH_VEC("isGreater", is_greater),
+    BENCH("multFiveEighths", mult_five_eighths),
+    BENCH_VEC("logicalNeg", logical_neg),
+    BENCH("twosComp2SignMag", twos_comp_2_sign_mag),
+    BENCH_VEC("isPower2", is_power2),
+};
+
+static double fastest(double (*run)(void)) {
+  double best = run();
+  for (int i = 1; i < RUNS; i++) {
+    double time = run();
+    best = (time < best) ? time : best;
+  }
+  return best;
+}
+
+// Mix of random values, small values and edge cases, with a share of equal
+// and neighbouring pairs so comparisons see every case
+static void fill_inputs(void) {
+  uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+  for (int i = 0; i < ARRAY_LEN; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    int value = (int)(uint32_t)state;
+    switch (i % 8) {
+    case 0:
+      value &= 0xFF;
+      break;
+    case 1:
+      value = (i & 8) ? INT_MAX : -1;
+      break;
+    default:
+      break;
+    }
+    in_a[i] = (value == INT_MIN) ? 0 : value;
+    in_b[i] = (i % 4 == 0) ? in_a[i] : (int)(uint32_t)(state >> 32);
+    in_c[i] = (int)(uint32_t)(state >> 16);
+  }
+}
+
+int main(void) {
+  fill_inputs();
+  open_cycle_counter();
+
+  const char *counter = (perf_fd >= 0) ? "perf_cycles" : "rdtsc";
+
+  // Untimed warm-up so the core reaches its steady clock before the baseline
+  for (int i = 0; i < RUNS; i++) {
+    chain_latency();
+    chain_throughput();
+  }
+  double chain_latency_cycles = fastest(chain_latency);
+  double chain_throughput_cycles = fastest(chain_throughput);
+
+  printf("function,impl,mode,cycles,net_cycles,elements_per_cycle,counter,"
+         "compiler,flags\n");
+  for (size_t i = 0; i < sizeof(BENCHES) / sizeof(*BENCHES); i++) {
+    const bench_t *bench = &BENCHES[i];
+
+    if (bench->latency != NULL) {
+      double latency = fastest(bench->latency);
+      printf("%s,%s,latency,%.3f,%.3f,,%s,\"%s\",\"%s\"\n", bench->function,
+             bench->impl, latency, latency - chain_latency_cycles, counter,
+             __VERSION__, BUILD_FLAGS);
+    }
+    double throughput = fastest(bench->throughput);
+    printf("%s,%s,throughput,%.3f,%.3f,%.3f,%s,\"%s\",\"%s\"\n",
+           bench->function, bench->impl, throughput,
+           throughput - chain_throughput_cycles, 1.0 / throughput, counter,
+           __VERSION__, BUILD_FLAGS);
+  }
+  return 0;
+}
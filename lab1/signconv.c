@@ -0,0 +1,205 @@
+/*
+ * signconv.c - Sign-magnitude, zigzag and varint conversions, with SSE2, AVX2
+ *              and AVX-512 kernels for the element-wise ones chosen at startup.
+ *
+ * Each element-wise conversion is written once as an expression over a signed
+ * type s and unsigned type u, and instantiated for int and for every vector
+ * width, like the kernels in bits_vec.c. All of them are the twosComp2SignMag
+ * idea: x >> 31 is 0 or -1, and (v ^ sign) - sign negates v exactly when the
+ * sign is -1.
+ *
+ * Varints are written branch-free, 64 bits at a time: the 7-bit groups of the
+ * zigzag value are spread into bytes with shifts and masks, the continuation
+ * bits are ORed in for every byte below the length, and all 8 bytes are
+ * stored before advancing by the length. Decoding loads 8 bytes, finds the
+ * first byte without a continuation bit and gathers the groups back.
+ */
+#include "signconv.h"
+
+#include <string.h>
+
+#include "cpu_isa.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIGNCONV_X86
+#endif
+
+#define MAX_VARINT_BYTES 5
+#define CONTINUATION_BITS 0x0000008080808080ULL /* bit 7 of bytes 0 to 4 */
+
+// twosComp2SignMag: the magnitude, with the sign moved to bit 31
+#define TO_SIGNMAG(x, s, u)                                                    \
+  ((s)((((u)(x) ^ (u)((x) >> 31)) - (u)((x) >> 31)) |                          \
+       ((u)((x) >> 31) & 0x80000000U)))
+
+// The magnitude, negated when bit 31 is set
+#define FROM_SIGNMAG(x, s, u)                                                  \
+  ((s)((((u)(x) & 0x7FFFFFFFU) ^ (u)((x) >> 31)) - (u)((x) >> 31)))
+
+// 2x for x >= 0, -2x - 1 for x < 0
+#define ZIGZAG_ENCODE(x, s, u) ((s)(((u)(x) << 1) ^ (u)((x) >> 31)))
+
+#define ZIGZAG_DECODE(x, s, u) ((s)(((u)(x) >> 1) ^ (0U - ((u)(x) & 1U))))
+
+typedef void (*convert_kernel)(const int *in, int *out, size_t n);
+
+struct kernels {
+  convert_kernel to_signmag;
+  convert_kernel from_signmag;
+  convert_kernel zigzag_encode;
+  convert_kernel zigzag_decode;
+};
+
+#define DEFINE_SCALAR(name, convert)                                           \
+  static void name##_scalar(const int *in, int *out, size_t n) {               \
+    for (size_t i = 0; i < n; i++) {                                           \
+      out[i] = convert(in[i], int, unsigned);                                  \
+    }                                                                          \
+  }
+
+DEFINE_SCALAR(to_signmag, TO_SIGNMAG)
+DEFINE_SCALAR(from_signmag, FROM_SIGNMAG)
+DEFINE_SCALAR(zigzag_encode, ZIGZAG_ENCODE)
+DEFINE_SCALAR(zigzag_decode, ZIGZAG_DECODE)
+
+#ifdef SIGNCONV_X86
+
+/*
+ * DEFINE_KERNEL(name, convert, isa, isa_target, bytes) - one conversion for
+ *     one instruction set; the tail goes through the scalar version. Each
+ *     vector is loaded before its store, so out may alias in.
+ */
+#define DEFINE_KERNEL(name, convert, isa, isa_target, bytes)                   \
+  __attribute__((target(isa_target))) static void name##_##isa(                \
+      const int *in, int *out, size_t n) {                                     \
+    const size_t lanes = (bytes) / sizeof(int);                                \
+    size_t i = 0;                                                              \
+    for (; i + lanes <= n; i += lanes) {                                       \
+      vec_##isa x = *(const vec_##isa *)(in + i);                              \
+      *(vec_##isa *)(out + i) = convert(x, vec_##isa, uvec_##isa);             \
+    }                                                                          \
+    name##_scalar(in + i, out + i, n - i);                                     \
+  }
+
+#define DEFINE_KERNELS(isa, isa_target, bytes)                                 \
+  typedef int vec_##isa __attribute__((vector_size(bytes), aligned(4)));       \
+  typedef unsigned uvec_##isa __attribute__((vector_size(bytes)));             \
+  DEFINE_KERNEL(to_signmag, TO_SIGNMAG, isa, isa_target, bytes)                \
+  DEFINE_KERNEL(from_signmag, FROM_SIGNMAG, isa, isa_target, bytes)            \
+  DEFINE_KERNEL(zigzag_encode, ZIGZAG_ENCODE, isa, isa_target, bytes)          \
+  DEFINE_KERNEL(zigzag_decode, ZIGZAG_DECODE, isa, isa_target, bytes)
+
+DEFINE_KERNELS(sse2, "sse2", 16)
+DEFINE_KERNELS(avx2, "avx2", 32)
+DEFINE_KERNELS(avx512, "avx512f,avx512bw", 64)
+
+#endif
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static struct kernels active = {to_signmag_scalar, from_signmag_scalar,
+                                zigzag_encode_scalar, zigzag_decode_scalar};
+
+__attribute__((constructor)) static void select_kernels(void) {
+  switch (cpu_isa_level()) {
+#ifdef SIGNCONV_X86
+  case ISA_AVX512:
+    active = (struct kernels){to_signmag_avx512, from_signmag_avx512,
+                              zigzag_encode_avx512, zigzag_decode_avx512};
+    break;
+  case ISA_AVX2:
+    active = (struct kernels){to_signmag_avx2, from_signmag_avx2,
+                              zigzag_encode_avx2, zigzag_decode_avx2};
+    break;
+  case ISA_SSE2:
+    active = (struct kernels){to_signmag_sse2, from_signmag_sse2,
+                              zigzag_encode_sse2, zigzag_decode_sse2};
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+void twos_to_signmag_n(const int *in, int *out, size_t n) {
+  active.to_signmag(in, out, n);
+}
+
+void signmag_to_twos_n(const int *in, int *out, size_t n) {
+  active.from_signmag(in, out, n);
+}
+
+void zigzag_encode_n(const int *in, unsigned *out, size_t n) {
+  active.zigzag_encode(in, (int *)out, n);
+}
+
+void zigzag_decode_n(const unsigned *in, int *out, size_t n) {
+  active.zigzag_decode((const int *)in, out, n);
+}
+
+// Varint bytes are in memory order; the 64-bit words hold byte 0 lowest
+static inline uint64_t to_little_endian(uint64_t word) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap64(word);
+#else
+  return word;
+#endif
+}
+
+size_t varint_encode_n(const int *in, size_t n, uint8_t *out) {
+  uint8_t *start = out;
+
+  for (size_t i = 0; i < n; i++) {
+    uint64_t zigzag = (unsigned)ZIGZAG_ENCODE(in[i], int, unsigned);
+    // ceil(significant bits / 7), at least 1
+    int length = (38 - __builtin_clz((unsigned)zigzag | 1)) / 7;
+    uint64_t word = (zigzag & 0x7F) | ((zigzag & 0x3F80) << 1) |
+                    ((zigzag & 0x1FC000) << 2) | ((zigzag & 0xFE00000) << 3) |
+                    ((zigzag & 0xF0000000) << 4);
+    word |= CONTINUATION_BITS & ((1ULL << (8 * (length - 1))) - 1);
+    word = to_little_endian(word);
+    memcpy(out, &word, sizeof(word));
+    out += length;
+  }
+  return (size_t)(out - start);
+}
+
+size_t varint_decode_n(const uint8_t *in, size_t len, int *out, size_t n) {
+  const uint8_t *start = in;
+  const uint8_t *end = in + len;
+
+  for (size_t i = 0; i < n; i++) {
+    size_t available = (size_t)(end - in);
+    uint64_t word = 0;
+    // A constant-size copy is a single load; only the last few bytes of the
+    // input need the variable one
+    if (available >= sizeof(word)) {
+      memcpy(&word, in, sizeof(word));
+    } else {
+      memcpy(&word, in, available);
+    }
+    word = to_little_endian(word);
+
+    // Bytes past the end read as 0, which looks like a last byte, so the
+    // length is checked against what is available
+    uint64_t last_bytes = ~word & CONTINUATION_BITS;
+    if (last_bytes == 0) {
+      return 0;
+    }
+    int length = (__builtin_ctzll(last_bytes) >> 3) + 1;
+    if ((size_t)length > available) {
+      return 0;
+    }
+    word &= ~0ULL >> (64 - 8 * length);
+    if (length == MAX_VARINT_BYTES && (word >> 32) > 0x0F) {
+      return 0;
+    }
+
+    unsigned zigzag =
+        (unsigned)((word & 0x7F) | ((word >> 1) & 0x3F80) |
+                   ((word >> 2) & 0x1FC000) | ((word >> 3) & 0xFE00000) |
+                   ((word >> 4) & 0xF0000000));
+    out[i] = ZIGZAG_DECODE(zigzag, int, unsigned);
+    in += length;
+  }
+  return (size_t)(in - start);
+}
@@ -0,0 +1,41 @@
+/*
+ * signconv.h - Batch conversions between two's complement, sign-magnitude,
+ *              zigzag and zigzag LEB128 varints.
+ *
+ * The element-wise conversions work on the caller's arrays and out may alias
+ * in, so a buffer can be converted in place. Sign-magnitude puts the sign in
+ * bit 31 and the magnitude below it, as twosComp2SignMag in bits.c does;
+ * zigzag maps 0, -1, 1, -2, ... to 0, 1, 2, 3, ... so small magnitudes of
+ * either sign become small unsigned numbers.
+ */
+#ifndef SIGNCONV_H
+#define SIGNCONV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// twosComp2SignMag for every element. INT_MIN, which has no sign-magnitude
+// form, becomes negative zero (0x80000000).
+void twos_to_signmag_n(const int *in, int *out, size_t n);
+
+// The inverse; negative zero becomes 0
+void signmag_to_twos_n(const int *in, int *out, size_t n);
+
+void zigzag_encode_n(const int *in, unsigned *out, size_t n);
+void zigzag_decode_n(const unsigned *in, int *out, size_t n);
+
+// Bytes varint_encode_n may write for n values: up to 5 per value, plus
+// slack for its 8-byte stores
+#define VARINT_BOUND(n) (5 * (n) + 3)
+
+// Zigzag encodes each value and writes it as an LEB128 varint (7 bits per
+// byte, low bits first, high bit set on every byte but the last). out must
+// hold VARINT_BOUND(n) bytes. Returns the number of bytes used.
+size_t varint_encode_n(const int *in, size_t n, uint8_t *out);
+
+// Decodes n values from the len bytes at in. Returns the number of bytes
+// read, or 0 if in ends early or holds a varint longer than 5 bytes or wider
+// than 32 bits.
+size_t varint_decode_n(const uint8_t *in, size_t len, int *out, size_t n);
+
+#endif
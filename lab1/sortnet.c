@@ -0,0 +1,213 @@
+/*
+ * sortnet.c - Sorting networks and bitonic merges built from branch-free
+ *             compare-exchanges.
+ *
+ * Small arrays use Batcher's odd-even merge sort network for 32 inputs. A
+ * network for n < 32 inputs is the same network with every comparator that
+ * touches an index >= n dropped: that is exactly what the full network would
+ * do with the missing inputs set to +infinity, since those never move. The
+ * pruned comparator lists for every n are built once at startup.
+ *
+ * Larger arrays are padded with INT_MAX to a power of 2, sorted in runs of 32
+ * and merged pairwise with bitonic merges. Reversing the second run turns two
+ * ascending runs into one bitonic sequence, which is then merged by
+ * compare-exchanges at strides n/2, n/4, ..., 1. Strides of at least a vector
+ * width compare whole vectors, so those steps are plain vector min/max lanes.
+ */
+#include "sortnet.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_isa.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SORTNET_X86
+#endif
+
+#define NETWORK_SIZE 32         /* inputs of the full network (power of 2) */
+#define NETWORK_COMPARATORS 191 /* comparators in the 32-input network */
+#define STACK_SCRATCH_INTS 1024 /* larger sorts malloc their scratch copy */
+
+typedef struct {
+  uint8_t lo;
+  uint8_t hi;
+} comparator_t;
+
+typedef void (*merge_kernel)(int *a, size_t n);
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+static comparator_t networks[SORTNET_MAX + 1][NETWORK_COMPARATORS];
+static size_t network_len[SORTNET_MAX + 1];
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+/*
+ * compare_exchange - puts the smaller of a[lo] and a[hi] in a[lo]. The
+ *     comparison becomes a mask as in conditional, and XORing the masked
+ *     difference into both slots swaps them only when the mask is set.
+ */
+static inline void compare_exchange(int *a, size_t lo, size_t hi) {
+  int x = a[lo];
+  int y = a[hi];
+  int swap_mask = -(x > y);
+  int diff = (x ^ y) & swap_mask;
+  a[lo] = x ^ diff;
+  a[hi] = y ^ diff;
+}
+
+static void add_comparator(size_t lo, size_t hi) {
+  for (size_t n = hi + 1; n <= SORTNET_MAX; n++) {
+    networks[n][network_len[n]++] = (comparator_t){(uint8_t)lo, (uint8_t)hi};
+  }
+}
+
+// Batcher's odd-even merge sort, in the iterative form from Knuth 5.3.4
+__attribute__((constructor)) static void build_networks(void) {
+  for (size_t p = 1; p < NETWORK_SIZE; p <<= 1) {
+    for (size_t k = p; k >= 1; k >>= 1) {
+      for (size_t j = k % p; j + k < NETWORK_SIZE; j += 2 * k) {
+        for (size_t i = 0; i < k && i + j + k < NETWORK_SIZE; i++) {
+          if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+            add_comparator(i + j, i + j + k);
+          }
+        }
+      }
+    }
+  }
+}
+
+void sortnet_small(int *a, size_t n) {
+  const comparator_t *network = networks[n];
+  for (size_t i = 0; i < network_len[n]; i++) {
+    compare_exchange(a, network[i].lo, network[i].hi);
+  }
+}
+
+// Merge steps for strides from stride down to 1, one element pair at a time
+static void merge_strides_scalar(int *a, size_t n, size_t stride) {
+  for (; stride >= 1; stride >>= 1) {
+    for (size_t block = 0; block < n; block += 2 * stride) {
+      for (size_t i = block; i < block + stride; i++) {
+        compare_exchange(a, i, i + stride);
+      }
+    }
+  }
+}
+
+static void merge_scalar(int *a, size_t n) {
+  merge_strides_scalar(a, n, n / 2);
+}
+
+#ifdef SORTNET_X86
+
+/*
+ * DEFINE_MERGE(isa, isa_target, bytes) - bitonic merge kernel for one
+ *     instruction set with bytes-wide vectors. Strides down to one vector
+ *     compare-exchange whole vectors (the min/max lanes), and the remaining
+ *     narrow strides fall back to merge_strides_scalar.
+ */
+#define DEFINE_MERGE(isa, isa_target, bytes)                                   \
+  typedef int vec_##isa __attribute__((vector_size(bytes), aligned(4)));       \
+                                                                               \
+  __attribute__((target(isa_target))) static void merge_##isa(int *a,          \
+                                                              size_t n) {      \
+    const size_t lanes = (bytes) / sizeof(int);                                \
+    size_t stride = n / 2;                                                     \
+    for (; stride >= lanes; stride >>= 1) {                                    \
+      for (size_t block = 0; block < n; block += 2 * stride) {                 \
+        for (size_t i = block; i < block + stride; i += lanes) {               \
+          vec_##isa x = *(vec_##isa *)(a + i);                                 \
+          vec_##isa y = *(vec_##isa *)(a + i + stride);                        \
+          vec_##isa diff = (x ^ y) & (x > y);                                  \
+          *(vec_##isa *)(a + i) = x ^ diff;                                    \
+          *(vec_##isa *)(a + i + stride) = y ^ diff;                           \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+    merge_strides_scalar(a, n, stride);                                        \
+  }
+
+DEFINE_MERGE(sse2, "sse2", 16)
+DEFINE_MERGE(avx2, "avx2", 32)
+DEFINE_MERGE(avx512, "avx512f", 64)
+
+#endif
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static merge_kernel active_merge = merge_scalar;
+
+__attribute__((constructor)) static void select_merge(void) {
+  switch (cpu_isa_level()) {
+#ifdef SORTNET_X86
+  case ISA_AVX512:
+    active_merge = merge_avx512;
+    break;
+  case ISA_AVX2:
+    active_merge = merge_avx2;
+    break;
+  case ISA_SSE2:
+    active_merge = merge_sse2;
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+void sortnet_bitonic_merge(int *a, size_t n) {
+  if (n < 2) {
+    return;
+  }
+
+  // Reverse the second half so the whole array rises then falls
+  for (size_t i = n / 2, j = n - 1; i < j; i++, j--) {
+    int temp = a[i];
+    a[i] = a[j];
+    a[j] = temp;
+  }
+  active_merge(a, n);
+}
+
+int sortnet_sort(int *a, size_t n) {
+  if (n <= SORTNET_MAX) {
+    sortnet_small(a, n);
+    return 0;
+  }
+
+  size_t padded = NETWORK_SIZE;
+  while (padded < n) {
+    padded <<= 1;
+  }
+
+  int stack_scratch[STACK_SCRATCH_INTS];
+  int *scratch = stack_scratch;
+  if (padded > STACK_SCRATCH_INTS) {
+    scratch = malloc(padded * sizeof(int));
+    if (scratch == NULL) {
+      return -1;
+    }
+  }
+
+  memcpy(scratch, a, n * sizeof(int));
+  for (size_t i = n; i < padded; i++) {
+    scratch[i] = INT_MAX;
+  }
+
+  // Runs made only of padding are already sorted
+  for (size_t run = 0; run < n; run += NETWORK_SIZE) {
+    sortnet_small(scratch + run, NETWORK_SIZE);
+  }
+  for (size_t width = 2 * NETWORK_SIZE; width <= padded; width <<= 1) {
+    for (size_t run = 0; run < n; run += width) {
+      sortnet_bitonic_merge(scratch + run, width);
+    }
+  }
+
+  memcpy(a, scratch, n * sizeof(int));
+  if (scratch != stack_scratch) {
+    free(scratch);
+  }
+  return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * sortnet.h - Branch-free sorting of int arrays with sorting networks.
+ *
+ * Every compare-exchange is the conditional trick from bits.c: a comparison
+ * turned into an all-ones/all-zeros mask selects which value goes where, so
+ * the work done never depends on the data and random input costs the same as
+ * sorted input. All functions sort ascending, in place.
+ */
+#ifndef SORTNET_H
+#define SORTNET_H
+
+#include <stddef.h>
+
+// Largest n sortnet_small handles
+#define SORTNET_MAX 32
+
+// Sorts n <= SORTNET_MAX elements with a fixed network
+void sortnet_small(int *a, size_t n);
+
+// Merges the two ascending halves of a into one ascending run. n must be a
+// power of 2; the wide steps use the SSE2, AVX2 or AVX-512 kernel picked at
+// startup (see cpu_isa.h).
+void sortnet_bitonic_merge(int *a, size_t n);
+
+// Sorts any n: networks for runs of SORTNET_MAX, then bitonic merges. Returns
+// 0, or -1 (leaving a untouched) if a large array's scratch copy cannot be
+// allocated.
+int sortnet_sort(int *a, size_t n);
+
+#endif
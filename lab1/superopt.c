@@ -0,0 +1,1177 @@
+/*
+ * superopt.c - Enumerative superoptimizer for the Data Lab integer rules.
+ *
+ * Searches for the expression with the fewest operators that computes one of
+ * the bits.c functions, using only what dlc allows: the arguments, constants
+ * 0 through 255 and the operators ! ~ & ^ | + << >> (further restricted per
+ * function, as in the bits.c headers).
+ *
+ * Expressions are enumerated bottom-up in order of increasing size, and
+ * operators are counted as dlc counts them: a subexpression used twice counts
+ * once. Each one is evaluated on a small set of test vectors, and expressions
+ * whose outputs match one already seen are dropped (keeping the one with fewer
+ * operators, then the shallower one), so the search only grows through
+ * distinct functions.
+ *
+ * Once the store is full, the search joins instead of growing: every stored
+ * expression, and every one of the size that did not fit, is tried as B in
+ * A ^ B and A + B, with A looked up in the store rather than enumerated. For
+ * functions that return 0 or 1, an expression E is also accepted if it is
+ * negative exactly where the result is 0 (giving !(E >> 31)) or 1 (giving
+ * (E >> 31) & 1), and then A ^ B only needs the right sign bits. This reaches
+ * about twice the size that fits, and joins that share subexpressions between
+ * A and B cost less than their parts.
+ *
+ * A candidate that matches the reference on every test vector is then checked
+ * exhaustively: over all 2^32 inputs for unary functions, and over every pair
+ * of edge values, a dense square around 0 and random pairs for binary ones, on
+ * all cores (exhaustive.c). A failed check adds the counterexample to the test
+ * vectors and restarts the search.
+ *
+ * The result is printed as a dlc-style function body, with repeated
+ * subexpressions bound to variables so they are only counted once.
+ *
+ * Usage: superopt FUNCTION [MAX_OPS [NODE_LIMIT]]
+ *        superopt FUNCTION -e EXPRESSION
+ *
+ * The second form skips the search and verifies a hand-written expression
+ * over x (and y), e.g. superopt isTmax -e '!(~(x + 1) ^ x | !(x + 1))'.
+ *
+ * Build: gcc -O2 -pthread -o superopt superopt.c exhaustive.c
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "exhaustive.h"
+
+#define NVEC 32                /* test vectors per fingerprint */
+#define BATCH EXHAUSTIVE_BATCH /* inputs per batch during verification */
+#define MAX_SIZE 32            /* largest expression (in operators) handled */
+#define RANDOM_PAIRS (1 << 26) /* random pairs checked for binary functions */
+#define RESULT_NODES 8         /* nodes kept free to build the result in */
+#define SIGN_TRIES 16          /* stored nodes tried per sign bits looked up */
+#define FILTER_LOG 26          /* log2 of the bits in value_filter */
+
+enum op {
+  OP_X,
+  OP_Y,
+  OP_CONST,
+  OP_NOT, /* ! */
+  OP_INV, /* ~ */
+  OP_AND,
+  OP_XOR,
+  OP_OR,
+  OP_ADD,
+  OP_SHL,
+  OP_SAR,
+  OP_COUNT
+};
+
+static const char *const OP_SYMBOL[OP_COUNT] = {"x", "y", "",  "!",  "~", "&",
+                                                "^", "|", "+", "<<", ">>"};
+
+#define OP_BIT(op) (1U << (op))
+#define ALL_OPS                                                                \
+  (OP_BIT(OP_NOT) | OP_BIT(OP_INV) | OP_BIT(OP_AND) | OP_BIT(OP_XOR) |         \
+   OP_BIT(OP_OR) | OP_BIT(OP_ADD) | OP_BIT(OP_SHL) | OP_BIT(OP_SAR))
+
+typedef struct {
+  uint8_t op;
+  uint8_t size;  /* operators, counting shared subexpressions once */
+  uint8_t depth; /* critical path length */
+  int32_t a;     /* left operand, or the value of a constant */
+  int32_t b;     /* right operand */
+} node_t;
+
+typedef struct {
+  const char *name;
+  int arity;
+  uint32_t legal_ops;
+  int32_t (*reference)(int32_t x, int32_t y);
+} target_t;
+
+/*
+ * Reference implementations, written with unsigned arithmetic so that
+ * overflow wraps the way dlc assumes instead of being undefined
+ */
+static int32_t ref_is_tmax(int32_t x, int32_t y) {
+  (void)y;
+  return x == INT32_MAX;
+}
+
+static int32_t ref_is_equal(int32_t x, int32_t y) { return x == y; }
+
+static int32_t ref_is_greater(int32_t x, int32_t y) { return x > y; }
+
+static int32_t ref_mult_five_eighths(int32_t x, int32_t y) {
+  (void)y;
+  return (int32_t)((uint32_t)x * 5U) / 8;
+}
+
+static int32_t ref_logical_neg(int32_t x, int32_t y) {
+  (void)y;
+  return !x;
+}
+
+static int32_t ref_is_power2(int32_t x, int32_t y) {
+  (void)y;
+  return x > 0 && (x & (x - 1)) == 0;
+}
+
+static const target_t TARGETS[] = {
+    {"isTmax", 1,
+     OP_BIT(OP_NOT) | OP_BIT(OP_INV) | OP_BIT(OP_AND) | OP_BIT(OP_XOR) |
+         OP_BIT(OP_OR) | OP_BIT(OP_ADD),
+     ref_is_tmax},
+    {"isEqual", 2, ALL_OPS, ref_is_equal},
+    {"isGreater", 2, ALL_OPS, ref_is_greater},
+    {"multFiveEighths", 1, ALL_OPS, ref_mult_five_eighths},
+    {"logicalNeg", 1, ALL_OPS & ~OP_BIT(OP_NOT), ref_logical_neg},
+    {"isPower2", 1, ALL_OPS, ref_is_power2},
+};
+
+// Leaf constants. Shift amounts dominate what is useful; larger constants can
+// still be built by the search.
+static const int32_t CONSTANTS[] = {0, 1, 2, 8, 16, 31};
+
+// How a boolean target is read off an expression E
+enum wrap {
+  WRAP_NONE, /* E is the target */
+  WRAP_NOT,  /* !(E >> 31): E is negative exactly where the target is 0 */
+  WRAP_AND,  /* (E >> 31) & 1: E is negative exactly where it is 1 */
+  WRAPS
+};
+
+// A candidate E, or its wrap, where E is B or joined ^/+ B, and B is
+// b_op(b_a, b_b) or, if b_op < 0, the stored node b_a
+typedef struct {
+  int cost; /* operators, counting shared subexpressions once */
+  int b_op;
+  int32_t b_a;
+  int32_t b_b;
+  int join_op; /* OP_XOR, OP_ADD, or -1 if E is B */
+  int32_t joined;
+  int wrap;
+} shape_t;
+
+typedef struct {
+  uint32_t signs; /* sign bits on the test vectors, as sign_bits */
+  int32_t index;
+} sign_entry_t;
+
+/* Expression store */
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+static node_t *nodes;
+static int32_t *values; /* NVEC outputs per node */
+static size_t node_count;
+static size_t node_limit; /* plus RESULT_NODES allocated */
+static uint32_t *table;   /* open addressing, node index + 1 */
+static size_t table_mask;
+static uint32_t *mark; /* mark_ops stamps, one per node */
+static uint32_t mark_epoch;
+
+/* Search state */
+static shape_t best;
+static uint32_t wrap_signs[WRAPS]; /* sign bits each wrap needs */
+static bool wrap_ok[WRAPS];        /* wrap is legal for the target */
+static sign_entry_t *sign_index;   /* stored nodes, sorted by index_store */
+static size_t sign_count;
+static sign_entry_t *sign_table; /* open addressing, first entry + 1 */
+static uint64_t *value_filter;   /* filter_bit of the stored nodes */
+
+/* Test vectors */
+static int32_t vec_x[NVEC];
+static int32_t vec_y[NVEC];
+static int32_t vec_want[NVEC];
+static size_t next_replace; /* round robin slot for counterexamples */
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+static uint64_t xorshift(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/*
+ * eval_op - Apply op lane by lane. Returns false if a shift amount falls
+ *     outside 0..31, which dlc treats as unpredictable.
+ */
+static bool eval_op(int op, const int32_t *a, const int32_t *b, int32_t *out,
+                    size_t n) {
+  const uint32_t *ua = (const uint32_t *)a;
+  const uint32_t *ub = (const uint32_t *)b;
+  const int32_t max_shift = 31;
+
+  switch (op) {
+  case OP_NOT:
+    for (size_t i = 0; i < n; i++) {
+      out[i] = !a[i];
+    }
+    return true;
+  case OP_INV:
+    for (size_t i = 0; i < n; i++) {
+      out[i] = ~a[i];
+    }
+    return true;
+  case OP_AND:
+    for (size_t i = 0; i < n; i++) {
+      out[i] = a[i] & b[i];
+    }
+    return true;
+  case OP_XOR:
+    for (size_t i = 0; i < n; i++) {
+      out[i] = a[i] ^ b[i];
+    }
+    return true;
+  case OP_OR:
+    for (size_t i = 0; i < n; i++) {
+      out[i] = a[i] | b[i];
+    }
+    return true;
+  case OP_ADD:
+    for (size_t i = 0; i < n; i++) {
+      out[i] = (int32_t)(ua[i] + ub[i]);
+    }
+    return true;
+  case OP_SHL:
+  case OP_SAR: {
+    int32_t bad = 0;
+    for (size_t i = 0; i < n; i++) {
+      bad |= (uint32_t)b[i] > (uint32_t)max_shift;
+    }
+    if (bad) {
+      return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+      out[i] = (op == OP_SHL) ? (int32_t)(ua[i] << b[i]) : a[i] >> b[i];
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+static uint64_t fingerprint(const int32_t *vals) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < NVEC; i++) {
+    hash = (hash ^ (uint32_t)vals[i]) * 0x100000001b3ULL;
+  }
+  return hash ^ (hash >> 29);
+}
+
+static void reset_store(void) {
+  node_count = 0;
+  memset(table, 0, (table_mask + 1) * sizeof(*table));
+}
+
+// Marks the operators under index that are not marked yet, returning how
+// many there were
+static int mark_ops(int32_t index) {
+  const node_t *node = &nodes[index];
+
+  if (node->op <= OP_CONST || mark[index] == mark_epoch) {
+    return 0;
+  }
+  mark[index] = mark_epoch;
+  int count = 1 + mark_ops(node->a);
+  if (node->op > OP_INV) {
+    count += mark_ops(node->b);
+  }
+  return count;
+}
+
+// Operators in the expressions rooted at roots[0..n), shared ones counted once
+static int union_size(const int32_t *roots, int n) {
+  int count = 0;
+
+  if (++mark_epoch == 0) {
+    memset(mark, 0, (node_limit + RESULT_NODES) * sizeof(*mark));
+    mark_epoch = 1;
+  }
+  for (int i = 0; i < n; i++) {
+    count += mark_ops(roots[i]);
+  }
+  return count;
+}
+
+static int dag_size(int op, int32_t a, int32_t b) {
+  int32_t roots[2] = {a, b};
+  return (op > OP_CONST) ? 1 + union_size(roots, (op > OP_INV) ? 2 : 1) : 0;
+}
+
+static int tree_depth(int op, int32_t a, int32_t b) {
+  if (op <= OP_CONST) {
+    return 0;
+  }
+  if (op > OP_INV && nodes[b].depth > nodes[a].depth) {
+    return nodes[b].depth + 1;
+  }
+  return nodes[a].depth + 1;
+}
+
+// Appends a node without deduplication (used for leaves, parsed input and
+// the expression search builds at the end)
+static int32_t push_node(int op, int32_t a, int32_t b, const int32_t *vals) {
+  if (node_count >= node_limit + RESULT_NODES) {
+    return -1;
+  }
+
+  node_t *node = &nodes[node_count];
+  node->op = (uint8_t)op;
+  node->a = a;
+  node->b = b;
+  node->size = (uint8_t)dag_size(op, a, b);
+  node->depth = (uint8_t)tree_depth(op, a, b);
+  memcpy(&values[node_count * NVEC], vals, sizeof(int32_t) * NVEC);
+  return (int32_t)node_count++;
+}
+
+// The table slot of the node with these outputs, or the empty slot where it
+// would go
+static size_t find_slot(const int32_t *vals) {
+  size_t slot = fingerprint(vals) & table_mask;
+
+  while (table[slot] != 0 &&
+         memcmp(&values[(size_t)(table[slot] - 1) * NVEC], vals,
+                sizeof(int32_t) * NVEC) != 0) {
+    slot = (slot + 1) & table_mask;
+  }
+  return slot;
+}
+
+/*
+ * insert_node - Add a node with the given outputs unless one with the same
+ *     outputs exists. Returns the node index, -1 if it was a duplicate, and -2
+ *     when the store is full.
+ */
+static int32_t insert_node(int op, int32_t a, int32_t b, const int32_t *vals) {
+  size_t slot = find_slot(vals);
+
+  if (table[slot] != 0) {
+    // Same function: keep the version with fewer operators, or the shallower
+    // one if they tie. More than either operand is a cheap lower bound that
+    // settles most duplicates without walking them.
+    node_t *other = &nodes[table[slot] - 1];
+    int bound = 1 + nodes[a].size;
+    if (op > OP_INV && nodes[b].size >= nodes[a].size) {
+      bound = 1 + nodes[b].size;
+    }
+    if (op > OP_CONST && bound <= other->size) {
+      int size = dag_size(op, a, b);
+      int depth = tree_depth(op, a, b);
+      if (size < other->size ||
+          (size == other->size && depth < other->depth)) {
+        *other = (node_t){(uint8_t)op, (uint8_t)size, (uint8_t)depth, a, b};
+      }
+    }
+    return -1;
+  }
+
+  if (node_count >= node_limit) {
+    return -2;
+  }
+  int32_t index = push_node(op, a, b, vals);
+  table[slot] = (uint32_t)index + 1;
+  return index;
+}
+
+// Evaluates op(a, b) on the test vectors into vals. Returns false on an
+// invalid shift.
+static bool eval_node(int op, int32_t a, int32_t b, int32_t *vals) {
+  const int32_t *b_vals = (op > OP_INV) ? &values[(size_t)b * NVEC] : NULL;
+  return eval_op(op, &values[(size_t)a * NVEC], b_vals, vals, NVEC);
+}
+
+// Evaluates op(a, b) on the test vectors and inserts it. Returns as
+// insert_node, with -1 also covering invalid shifts.
+static int32_t intern_node(int op, int32_t a, int32_t b) {
+  int32_t vals[NVEC];
+
+  if (!eval_node(op, a, b, vals)) {
+    return -1;
+  }
+  return insert_node(op, a, b, vals);
+}
+
+static bool matches_target(int32_t index) {
+  return index >= 0 &&
+         memcmp(&values[(size_t)index * NVEC], vec_want, sizeof(vec_want)) == 0;
+}
+
+// Adds the arguments and constants, returning a leaf that already matches
+// the target (for constant functions) or -1
+static int32_t add_leaves(const target_t *target) {
+  int32_t vals[NVEC];
+  int32_t found = -1;
+
+  if (matches_target(insert_node(OP_X, 0, 0, vec_x))) {
+    found = 0;
+  }
+  if (target->arity == 2) {
+    int32_t index = insert_node(OP_Y, 0, 0, vec_y);
+    found = matches_target(index) ? index : found;
+  }
+  for (size_t i = 0; i < sizeof(CONSTANTS) / sizeof(*CONSTANTS); i++) {
+    for (size_t j = 0; j < NVEC; j++) {
+      vals[j] = CONSTANTS[i];
+    }
+    int32_t index = insert_node(OP_CONST, CONSTANTS[i], 0, vals);
+    found = matches_target(index) ? index : found;
+  }
+  return found;
+}
+
+static int32_t leaf_constant(int32_t value) {
+  int32_t index = 0;
+  while (nodes[index].op != OP_CONST || nodes[index].a != value) {
+    index++;
+  }
+  return index;
+}
+
+/* Boolean targets read off a sign bit, and candidates built from two parts */
+
+// Bit i set where test vector i is negative (NVEC is 32)
+static uint32_t sign_bits(const int32_t *vals) {
+  uint32_t signs = 0;
+  for (size_t i = 0; i < NVEC; i++) {
+    signs |= (uint32_t)(vals[i] < 0) << i;
+  }
+  return signs;
+}
+
+// Sets up wrap_signs and wrap_ok for the target on the current test vectors
+static void set_goals(const target_t *target) {
+  bool boolean = true;
+  uint32_t want = 0;
+
+  for (size_t i = 0; i < NVEC; i++) {
+    boolean = boolean && (vec_want[i] == 0 || vec_want[i] == 1);
+    want |= (uint32_t)(vec_want[i] != 0) << i;
+  }
+  bool sar = boolean && (target->legal_ops & OP_BIT(OP_SAR));
+  wrap_signs[WRAP_NOT] = ~want;
+  wrap_signs[WRAP_AND] = want;
+  wrap_ok[WRAP_NONE] = false;
+  wrap_ok[WRAP_NOT] = sar && (target->legal_ops & OP_BIT(OP_NOT));
+  wrap_ok[WRAP_AND] = sar && (target->legal_ops & OP_BIT(OP_AND));
+}
+
+// The wrap that turns an expression with these outputs into the target, or
+// WRAP_NONE
+static int sign_wrap(const int32_t *vals) {
+  uint32_t signs = sign_bits(vals);
+
+  for (int wrap = WRAP_NOT; wrap <= WRAP_AND; wrap++) {
+    if (wrap_ok[wrap] && signs == wrap_signs[wrap]) {
+      return wrap;
+    }
+  }
+  return WRAP_NONE;
+}
+
+// Operators in the candidate described by shape, shared ones counted once
+static int shape_cost(const shape_t *shape) {
+  int32_t roots[3];
+  int n = 0;
+  int cost = (shape->wrap != WRAP_NONE) ? 2 : 0;
+
+  if (shape->join_op >= 0) {
+    roots[n++] = shape->joined;
+    cost++;
+  }
+  roots[n++] = shape->b_a;
+  if (shape->b_op >= 0) {
+    cost++;
+    if (shape->b_op > OP_INV) {
+      roots[n++] = shape->b_b;
+    }
+  }
+  return cost + union_size(roots, n);
+}
+
+static void consider(shape_t shape) {
+  shape.cost = shape_cost(&shape);
+  if (shape.cost < best.cost) {
+    best = shape;
+  }
+}
+
+// Appends op(a, b) with its outputs, for build_best
+static int32_t append_node(int op, int32_t a, int32_t b) {
+  int32_t vals[NVEC];
+
+  eval_node(op, a, b, vals);
+  return push_node(op, a, b, vals);
+}
+
+// Appends the nodes of the best candidate and returns its root
+static int32_t build_best(void) {
+  int32_t root = best.b_a;
+
+  if (best.b_op >= 0) {
+    root = append_node(best.b_op, best.b_a, best.b_b);
+  }
+  if (best.join_op >= 0) {
+    root = append_node(best.join_op, best.joined, root);
+  }
+  if (best.wrap == WRAP_NONE) {
+    return root;
+  }
+  root = append_node(OP_SAR, root, leaf_constant(31));
+  if (best.wrap == WRAP_NOT) {
+    return append_node(OP_NOT, root, 0);
+  }
+  return append_node(OP_AND, root, leaf_constant(1));
+}
+
+static int compare_signs(const void *p, const void *q) {
+  const sign_entry_t *a = p;
+  const sign_entry_t *b = q;
+
+  if (a->signs != b->signs) {
+    return (a->signs < b->signs) ? -1 : 1;
+  }
+  return (int)nodes[a->index].size - (int)nodes[b->index].size;
+}
+
+// The value_filter bit for a hash of all the outputs that, unlike
+// fingerprint, vectorizes. A clear bit means no stored node has them, and
+// saves a lookup that would miss the cache.
+static uint64_t filter_bit(const int32_t *vals) {
+  uint32_t sum = 0;
+  uint32_t mix = 0;
+
+  for (size_t i = 0; i < NVEC; i++) {
+    sum += (uint32_t)vals[i] * (uint32_t)(2 * i + 1);
+    mix ^= (uint32_t)vals[i] * 0x9E3779B1U + (uint32_t)i;
+  }
+  return (((uint64_t)sum << 32 | mix) * 0x9E3779B97F4A7C15ULL) >>
+         (64 - FILTER_LOG);
+}
+
+// Where the probe for these sign bits starts in sign_table
+static size_t sign_home(uint32_t signs) {
+  return (size_t)((signs * 0x9E3779B97F4A7C15ULL) >> 32) & table_mask;
+}
+
+// The sign_table slot for these sign bits, or the empty slot where they
+// would go
+static size_t sign_slot(uint32_t signs) {
+  size_t slot = sign_home(signs);
+
+  while (sign_table[slot].index != 0 && sign_table[slot].signs != signs) {
+    slot = (slot + 1) & table_mask;
+  }
+  return slot;
+}
+
+// Sorts the stored nodes by sign bits, and by size among equal ones, for
+// find_signs, and fills value_filter
+static void index_store(void) {
+  memset(sign_table, 0, (table_mask + 1) * sizeof(*sign_table));
+  memset(value_filter, 0, (1ULL << FILTER_LOG) / 8);
+  for (size_t i = 0; i < node_count; i++) {
+    uint64_t bit = filter_bit(&values[i * NVEC]);
+    sign_index[i] = (sign_entry_t){sign_bits(&values[i * NVEC]), (int32_t)i};
+    value_filter[bit / 64] |= 1ULL << (bit % 64);
+  }
+  sign_count = node_count;
+  qsort(sign_index, sign_count, sizeof(*sign_index), compare_signs);
+
+  for (size_t i = sign_count; i-- > 0;) {
+    size_t slot = sign_slot(sign_index[i].signs);
+    sign_table[slot] = (sign_entry_t){sign_index[i].signs, (int32_t)i + 1};
+  }
+}
+
+// The first sign_index entry with these sign bits, or sign_count
+static size_t find_signs(uint32_t signs) {
+  size_t slot = sign_slot(signs);
+  return (sign_table[slot].index != 0) ? (size_t)sign_table[slot].index - 1
+                                       : sign_count;
+}
+
+/*
+ * try_joins - Consider the operand B in shape, with outputs vals and no fewer
+ *     than least operators: as the target itself, with a sign wrap, and
+ *     joined with a stored node A as A ^ B or A + B. A is looked up instead
+ *     of enumerated: A ^ B and A + B can be solved for A exactly, and under a
+ *     sign wrap A ^ B only has to get the sign bits right, which are sign(A)
+ *     ^ sign(B).
+ */
+static void try_joins(const target_t *target, shape_t shape,
+                      const int32_t *vals, int least) {
+  static const int JOIN_OPS[] = {OP_XOR, OP_ADD};
+  int32_t need[2][NVEC]; // the A that A ^ B and A + B need
+  uint64_t bit[2];
+
+  // The lookups usually miss the cache, so start them before anything waits
+  for (size_t i = 0; i < NVEC; i++) {
+    need[0][i] = vec_want[i] ^ vals[i];
+    need[1][i] = (int32_t)((uint32_t)vec_want[i] - (uint32_t)vals[i]);
+  }
+  for (size_t j = 0; j < 2; j++) {
+    bit[j] = filter_bit(need[j]);
+    __builtin_prefetch(&value_filter[bit[j] / 64]);
+  }
+  uint32_t signs = sign_bits(vals);
+  for (int wrap = WRAP_NOT; wrap <= WRAP_AND; wrap++) {
+    __builtin_prefetch(&sign_table[sign_home(signs ^ wrap_signs[wrap])]);
+  }
+
+  if (least < best.cost &&
+      memcmp(vals, vec_want, sizeof(vec_want)) == 0) {
+    consider(shape);
+  }
+  shape.wrap = sign_wrap(vals);
+  if (shape.wrap != WRAP_NONE && least + 2 < best.cost) {
+    consider(shape);
+  }
+  shape.wrap = WRAP_NONE;
+
+  for (size_t j = 0; j < 2; j++) {
+    shape.join_op = JOIN_OPS[j];
+    if (!(target->legal_ops & OP_BIT(shape.join_op)) ||
+        least + 1 >= best.cost ||
+        !(value_filter[bit[j] / 64] >> (bit[j] % 64) & 1)) {
+      continue;
+    }
+    size_t slot = find_slot(need[j]);
+    if (table[slot] != 0) {
+      shape.joined = (int32_t)(table[slot] - 1);
+      consider(shape);
+    }
+  }
+
+  shape.join_op = OP_XOR;
+  if (!(target->legal_ops & OP_BIT(OP_XOR))) {
+    return;
+  }
+  for (shape.wrap = WRAP_NOT; shape.wrap <= WRAP_AND; shape.wrap++) {
+    if (!wrap_ok[shape.wrap] || least + 3 >= best.cost) {
+      continue;
+    }
+    uint32_t want = signs ^ wrap_signs[shape.wrap];
+    size_t first = find_signs(want);
+    for (size_t i = first; i < first + SIGN_TRIES && i < sign_count; i++) {
+      if (sign_index[i].signs != want ||
+          nodes[sign_index[i].index].size + 3 >= best.cost) {
+        break;
+      }
+      shape.joined = sign_index[i].index;
+      consider(shape);
+    }
+  }
+}
+
+// Whatever is done with each combination for_each_combination enumerates:
+// returns -1 to go on, or a value to stop and return
+typedef int32_t (*visit_fn)(const target_t *target, int op, int32_t a,
+                            int32_t b);
+
+/*
+ * for_each_combination - Visit every legal op(a, b) whose operands were
+ *     enumerated at sizes adding up to size - 1, with bank_start[i] the first
+ *     node enumerated at size i
+ */
+static int32_t for_each_combination(const target_t *target, int size,
+                                    const size_t *bank_start, visit_fn visit) {
+  for (int op = OP_NOT; op < OP_COUNT; op++) {
+    if (!(target->legal_ops & OP_BIT(op))) {
+      continue;
+    }
+
+    bool commutative = op == OP_AND || op == OP_XOR || op == OP_OR ||
+                       op == OP_ADD;
+
+    if (op <= OP_INV) {
+      for (size_t a = bank_start[size - 1]; a < bank_start[size]; a++) {
+        int32_t result = visit(target, op, (int32_t)a, 0);
+        if (result != -1) {
+          return result;
+        }
+      }
+      continue;
+    }
+
+    // Split the remaining size - 1 operators between the two operands
+    for (int left = 0; left < size; left++) {
+      int right = size - 1 - left;
+      if (commutative && left > right) {
+        break;
+      }
+      for (size_t a = bank_start[left]; a < bank_start[left + 1]; a++) {
+        size_t b = (commutative && left == right) ? a : bank_start[right];
+        for (; b < bank_start[right + 1]; b++) {
+          int32_t result = visit(target, op, (int32_t)a, (int32_t)b);
+          if (result != -1) {
+            return result;
+          }
+        }
+      }
+    }
+  }
+  return -1;
+}
+
+// visit_fn: stores op(a, b), stopping at an exact match or a full store, and
+// keeps the cheapest sign-wrapped match
+static int32_t grow(const target_t *target, int op, int32_t a, int32_t b) {
+  (void)target;
+  int32_t index = intern_node(op, a, b);
+  if (index < 0 || matches_target(index)) {
+    return index;
+  }
+
+  int wrap = sign_wrap(&values[(size_t)index * NVEC]);
+  if (wrap != WRAP_NONE && nodes[index].size + 2 < best.cost) {
+    best = (shape_t){nodes[index].size + 2, -1, index, 0, -1, 0, wrap};
+  }
+  return -1;
+}
+
+// visit_fn: op(a, b) as the operand B of try_joins, without storing it
+static int32_t stream(const target_t *target, int op, int32_t a, int32_t b) {
+  int32_t vals[NVEC];
+
+  if (eval_node(op, a, b, vals)) {
+    int least = nodes[a].size;
+    if (op > OP_INV && nodes[b].size > least) {
+      least = nodes[b].size;
+    }
+    try_joins(target, (shape_t){0, op, a, b, -1, 0, WRAP_NONE}, vals,
+              least + 1);
+  }
+  return -1;
+}
+
+/*
+ * search - Enumerate expressions of up to max_ops operators, smallest first.
+ *     Returns the first node matching the target on every test vector, or the
+ *     cheapest sign-wrapped or joined candidate, -1 if there is none, or -2 if
+ *     the store filled up and joining found nothing either.
+ *
+ *     Once the store is full, the size that did not fit is enumerated again
+ *     without storing it, and each expression there and in the store is tried
+ *     as one operand of a join (try_joins), which reaches candidates about
+ *     twice the size that fits.
+ */
+static int32_t search(const target_t *target, int max_ops) {
+  size_t bank_start[MAX_SIZE + 2];
+
+  reset_store();
+  set_goals(target);
+  best = (shape_t){max_ops + 1, -1, 0, 0, -1, 0, WRAP_NONE};
+  int32_t found = add_leaves(target);
+  if (found >= 0) {
+    return found;
+  }
+  bank_start[0] = 0;
+  bank_start[1] = node_count;
+
+  // A sign-wrapped match is 2 operators more than what it wraps, so sizes
+  // below its cost can still hold something cheaper
+  for (int size = 1; size <= max_ops && size < best.cost; size++) {
+    found = for_each_combination(target, size, bank_start, grow);
+    if (found >= 0) {
+      return found;
+    }
+    if (found == -2) {
+      fprintf(stderr, "%d ops: store full at %zu distinct functions, joining\n",
+              size, node_count);
+      index_store();
+      for (size_t i = 0; i < sign_count; i++) {
+        try_joins(target, (shape_t){0, -1, (int32_t)i, 0, -1, 0, WRAP_NONE},
+                  &values[i * NVEC], nodes[i].size);
+      }
+      for_each_combination(target, size, bank_start, stream);
+      return (best.cost <= max_ops) ? build_best() : -2;
+    }
+    bank_start[size + 1] = node_count;
+    fprintf(stderr, "%d ops: %zu distinct functions so far\n", size,
+            node_count);
+  }
+
+  return (best.cost <= max_ops) ? build_best() : -1;
+}
+
+/*
+ * eval_tree - Evaluate the expression rooted at index on n inputs. Returns
+ *     false on an out-of-range shift.
+ */
+static bool eval_tree(int32_t index, const int32_t *xs, const int32_t *ys,
+                      int32_t *out, size_t n) {
+  const node_t *node = &nodes[index];
+  int32_t left[BATCH];
+  int32_t right[BATCH];
+
+  switch (node->op) {
+  case OP_X:
+    memcpy(out, xs, n * sizeof(int32_t));
+    return true;
+  case OP_Y:
+    memcpy(out, ys, n * sizeof(int32_t));
+    return true;
+  case OP_CONST:
+    for (size_t i = 0; i < n; i++) {
+      out[i] = node->a;
+    }
+    return true;
+  default:
+    break;
+  }
+
+  if (!eval_tree(node->a, xs, ys, left, n)) {
+    return false;
+  }
+  if (node->op > OP_INV && !eval_tree(node->b, xs, ys, right, n)) {
+    return false;
+  }
+  return eval_op(node->op, left, right, out, n);
+}
+
+// A candidate expression and the function it should compute
+typedef struct {
+  const target_t *target;
+  int32_t root;
+} candidate_t;
+
+// exhaustive_fn: checks one batch of inputs, returning the first mismatch
+static size_t check_batch(void *ctx, const int32_t *xs, const int32_t *ys,
+                          size_t n) {
+  const candidate_t *candidate = ctx;
+  int32_t got[BATCH];
+
+  if (!eval_tree(candidate->root, xs, ys, got, n)) {
+    return 0;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (got[i] != candidate->target->reference(xs[i], ys[i])) {
+      return i;
+    }
+  }
+  return n;
+}
+
+/*
+ * verify - Check a candidate against the reference with exhaustive.h: all
+ *     2^32 inputs for unary functions, and edge pairs, a dense square around
+ *     0 and random pairs (half of them close together, where comparisons are
+ *     hardest) for binary ones.
+ */
+static bool verify(const target_t *target, int32_t root, int32_t *bad_x,
+                   int32_t *bad_y) {
+  candidate_t candidate = {target, root};
+
+  if (target->arity == 1) {
+    return exhaustive_unary(check_batch, &candidate, bad_x, bad_y);
+  }
+  return exhaustive_binary(check_batch, &candidate, RANDOM_PAIRS, bad_x,
+                           bad_y);
+}
+
+/* Printing, with shared subexpressions bound to variables */
+
+static void count_uses(int32_t index, int *uses) {
+  if (uses[index]++ > 0 || nodes[index].op <= OP_CONST) {
+    return;
+  }
+  count_uses(nodes[index].a, uses);
+  if (nodes[index].op > OP_INV) {
+    count_uses(nodes[index].b, uses);
+  }
+}
+
+static void print_expr(int32_t index, const int *var) {
+  const node_t *node = &nodes[index];
+
+  if (var[index] >= 0) {
+    printf("t%d", var[index]);
+  } else if (node->op == OP_CONST) {
+    printf("%d", node->a);
+  } else if (node->op <= OP_Y) {
+    printf("%s", OP_SYMBOL[node->op]);
+  } else if (node->op <= OP_INV) {
+    printf("%s", OP_SYMBOL[node->op]);
+    print_expr(node->a, var);
+  } else {
+    printf("(");
+    print_expr(node->a, var);
+    printf(" %s ", OP_SYMBOL[node->op]);
+    print_expr(node->b, var);
+    printf(")");
+  }
+}
+
+// Declares shared operator nodes in post-order so each is defined before use
+static void declare_shared(int32_t index, const int *uses, int *var,
+                           int *next_var) {
+  const node_t *node = &nodes[index];
+
+  if (node->op <= OP_CONST || var[index] >= 0) {
+    return;
+  }
+  declare_shared(node->a, uses, var, next_var);
+  if (node->op > OP_INV) {
+    declare_shared(node->b, uses, var, next_var);
+  }
+  if (uses[index] > 1) {
+    printf("  int t%d = ", *next_var);
+    print_expr(index, var);
+    printf(";\n");
+    var[index] = (*next_var)++;
+  }
+}
+
+// Prints the function body and returns its dlc operator count
+static int print_function(const target_t *target, int32_t root) {
+  int *uses = calloc(node_count, sizeof(int));
+  int *var = malloc(node_count * sizeof(int));
+  int next_var = 0;
+  int ops = 0;
+
+  count_uses(root, uses);
+  for (size_t i = 0; i < node_count; i++) {
+    var[i] = -1;
+    ops += uses[i] > 0 && nodes[i].op > OP_CONST;
+  }
+
+  printf("int %s(%s) {\n", target->name,
+         (target->arity == 2) ? "int x, int y" : "int x");
+  declare_shared(root, uses, var, &next_var);
+  printf("  return ");
+  print_expr(root, var);
+  printf(";\n}\n");
+
+  free(uses);
+  free(var);
+  return ops;
+}
+
+/*
+ * Expression parser for -e, following C precedence for the dlc operators:
+ * unary ! ~, then +, then << >>, then &, then ^, then |
+ */
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static const char *cursor;
+
+static int32_t parse_binary(int level);
+
+// Appends a parsed node, reusing an identical one so that repeated
+// subexpressions are shared (and counted once) like in the search
+static int32_t parsed_node(int op, int32_t a, int32_t b) {
+  int32_t zeros[NVEC] = {0};
+
+  for (size_t i = 0; i < node_count; i++) {
+    if (nodes[i].op == op && nodes[i].a == a && nodes[i].b == b) {
+      return (int32_t)i;
+    }
+  }
+  return push_node(op, a, b, zeros);
+}
+
+static void skip_space(void) {
+  while (*cursor == ' ' || *cursor == '\t') {
+    cursor++;
+  }
+}
+
+static int32_t parse_unary(void) {
+  skip_space();
+  if (*cursor == '!' || *cursor == '~') {
+    int op = (*cursor++ == '!') ? OP_NOT : OP_INV;
+    int32_t operand = parse_unary();
+    return (operand < 0) ? -1 : parsed_node(op, operand, 0);
+  }
+  if (*cursor == '(') {
+    cursor++;
+    int32_t inner = parse_binary(0);
+    skip_space();
+    if (*cursor++ != ')') {
+      return -1;
+    }
+    return inner;
+  }
+  if (*cursor == 'x' || *cursor == 'y') {
+    return parsed_node((*cursor++ == 'x') ? OP_X : OP_Y, 0, 0);
+  }
+
+  char *end = NULL;
+  long constant = strtol(cursor, &end, 0);
+  if (end == cursor || constant < 0 || constant > 255) {
+    return -1;
+  }
+  cursor = end;
+  return parsed_node(OP_CONST, (int32_t)constant, 0);
+}
+
+// Binary operators by increasing precedence
+static const struct {
+  const char *token;
+  int op;
+} BINARY_LEVELS[] = {{"|", OP_OR},   {"^", OP_XOR},  {"&", OP_AND},
+                     {"<<", OP_SHL}, {">>", OP_SAR}, {"+", OP_ADD}};
+static const int LEVEL_OF[] = {0, 1, 2, 3, 3, 4};
+static const int LEVEL_COUNT = 5;
+
+static int32_t parse_binary(int level) {
+  if (level == LEVEL_COUNT) {
+    return parse_unary();
+  }
+
+  int32_t left = parse_binary(level + 1);
+  for (;;) {
+    skip_space();
+    int op = -1;
+    size_t length = 0;
+    for (size_t i = 0; i < sizeof(BINARY_LEVELS) / sizeof(*BINARY_LEVELS);
+         i++) {
+      length = strlen(BINARY_LEVELS[i].token);
+      if (LEVEL_OF[i] == level &&
+          strncmp(cursor, BINARY_LEVELS[i].token, length) == 0) {
+        op = BINARY_LEVELS[i].op;
+        break;
+      }
+    }
+    if (op < 0 || left < 0) {
+      return left;
+    }
+    cursor += length;
+    int32_t right = parse_binary(level + 1);
+    if (right < 0) {
+      return -1;
+    }
+    left = parsed_node(op, left, right);
+  }
+}
+
+static void add_counterexample(const target_t *target, int32_t x, int32_t y) {
+  const size_t fixed = NVEC / 2; // the first half are never replaced
+
+  size_t slot = fixed + next_replace++ % (NVEC - fixed);
+  vec_x[slot] = x;
+  vec_y[slot] = y;
+  vec_want[slot] = target->reference(x, y);
+}
+
+static void init_vectors(const target_t *target) {
+  const int32_t edges[] = {0,         1,  -1, 2,  -2, INT32_MAX, INT32_MIN,
+                           INT32_MAX - 1, INT32_MIN + 1, 7,  8,  -8, 255,
+                           256,       429496730, -429496730};
+  const size_t edge_count = sizeof(edges) / sizeof(*edges);
+  uint64_t state = 0x2545f4914f6cdd1dULL;
+
+  for (size_t i = 0; i < NVEC; i++) {
+    vec_x[i] = (i < edge_count) ? edges[i] : (int32_t)xorshift(&state);
+    // Pair each x with equal, neighbouring and unrelated y values
+    switch (i % 4) {
+    case 0:
+      vec_y[i] = vec_x[i];
+      break;
+    case 1:
+      vec_y[i] = (int32_t)((uint32_t)vec_x[i] + 1);
+      break;
+    case 2:
+      vec_y[i] = (int32_t)((uint32_t)vec_x[i] - 1);
+      break;
+    default:
+      vec_y[i] = edges[(i * 7) % edge_count];
+      break;
+    }
+    vec_want[i] = target->reference(vec_x[i], vec_y[i]);
+  }
+}
+
+int main(int argc, char **argv) {
+  const target_t *target = NULL;
+
+  if (argc < 2) {
+    fprintf(stderr,
+            "usage: %s FUNCTION [MAX_OPS [NODE_LIMIT]]\n"
+            "       %s FUNCTION -e EXPRESSION\n",
+            argv[0], argv[0]);
+    return 2;
+  }
+  for (size_t i = 0; i < sizeof(TARGETS) / sizeof(*TARGETS); i++) {
+    if (strcmp(argv[1], TARGETS[i].name) == 0) {
+      target = &TARGETS[i];
+    }
+  }
+  if (target == NULL) {
+    fprintf(stderr, "unknown function %s\n", argv[1]);
+    return 2;
+  }
+
+  bool check_only = argc > 3 && strcmp(argv[2], "-e") == 0;
+  int max_ops = (argc > 2 && !check_only) ? atoi(argv[2]) : 8;
+  node_limit = (argc > 3 && !check_only) ? strtoull(argv[3], NULL, 0) : 1 << 22;
+  max_ops = (max_ops > MAX_SIZE) ? MAX_SIZE : max_ops;
+
+  size_t table_size = 1;
+  while (table_size < 2 * node_limit) {
+    table_size <<= 1;
+  }
+  size_t capacity = node_limit + RESULT_NODES;
+  nodes = malloc(capacity * sizeof(*nodes));
+  values = malloc(capacity * NVEC * sizeof(*values));
+  mark = calloc(capacity, sizeof(*mark));
+  table = calloc(table_size, sizeof(*table));
+  table_mask = table_size - 1;
+  sign_index = malloc(node_limit * sizeof(*sign_index));
+  sign_table = malloc(table_size * sizeof(*sign_table));
+  value_filter = malloc((1ULL << FILTER_LOG) / 8);
+  if (nodes == NULL || values == NULL || mark == NULL || table == NULL ||
+      sign_index == NULL || sign_table == NULL || value_filter == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  init_vectors(target);
+  int32_t bad_x = 0;
+  int32_t bad_y = 0;
+
+  if (check_only) {
+    cursor = argv[3];
+    int32_t root = parse_binary(0);
+    skip_space();
+    if (root < 0 || *cursor != '\0') {
+      fprintf(stderr, "cannot parse expression near \"%s\"\n", cursor);
+      return 2;
+    }
+    if (!verify(target, root, &bad_x, &bad_y)) {
+      printf("FAIL at x = %d, y = %d\n", bad_x, bad_y);
+      return 1;
+    }
+    int ops = print_function(target, root);
+    printf("verified, %d ops\n", ops);
+    return 0;
+  }
+
+  for (;;) {
+    int32_t root = search(target, max_ops);
+    if (root == -2) {
+      printf("gave up: nothing in %zu distinct functions or their joins\n",
+             node_limit);
+      return 1;
+    }
+    if (root < 0) {
+      printf("no expression with at most %d ops\n", max_ops);
+      return 1;
+    }
+    if (verify(target, root, &bad_x, &bad_y)) {
+      int ops = print_function(target, root);
+      printf("verified, %d ops, depth %d\n", ops, nodes[root].depth);
+      return 0;
+    }
+    fprintf(stderr, "candidate failed at x = %d, y = %d, refining\n", bad_x,
+            bad_y);
+    add_counterexample(target, bad_x, bad_y);
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ * memlib.c - Stand-in for the malloc lab's memory system model. The heap is
+ *            one MAX_HEAP region reserved by mem_init; mem_sbrk moves a break
+ *            through it and fails, like sbrk, once the region is used up.
+ */
+#include "memlib.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef MAX_HEAP
+#define MAX_HEAP (1 << 30) /* 1 GiB; override with -DMAX_HEAP=n */
+#endif
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+static char *mem_start_brk; /* first byte of the heap */
+static char *mem_brk;       /* current break */
+static char *mem_max_addr;  /* end of the region */
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+/*
+ * mem_init - Reserve the region the heap grows into
+ */
+void mem_init(void) {
+  mem_start_brk = malloc(MAX_HEAP);
+  if (mem_start_brk == NULL) {
+    fprintf(stderr, "mem_init: cannot reserve %d bytes\n", MAX_HEAP);
+    exit(1);
+  }
+  mem_brk = mem_start_brk;
+  mem_max_addr = mem_start_brk + MAX_HEAP;
+}
+
+/*
+ * mem_deinit - Release the region
+ */
+void mem_deinit(void) {
+  free(mem_start_brk);
+  mem_start_brk = mem_brk = mem_max_addr = NULL;
+}
+
+/*
+ * mem_reset_brk - Empty the heap, e.g. before the next mm_init
+ */
+void mem_reset_brk(void) { mem_brk = mem_start_brk; }
+
+/*
+ * mem_sbrk - Grow the heap by incr bytes and return the old break, or
+ *     (void *)-1 with errno set to ENOMEM. The heap cannot shrink.
+ */
+void *mem_sbrk(int incr) {
+  char *old_brk = mem_brk;
+
+  if (incr < 0 || incr > mem_max_addr - mem_brk) {
+    errno = ENOMEM;
+    return (void *)-1;
+  }
+  mem_brk += incr;
+  return old_brk;
+}
+
+void *mem_heap_lo(void) { return mem_start_brk; }
+
+void *mem_heap_hi(void) { return mem_brk - 1; }
+
+size_t mem_heapsize(void) { return (size_t)(mem_brk - mem_start_brk); }
+
+size_t mem_pagesize(void) { return (size_t)getpagesize(); }
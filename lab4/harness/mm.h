@@ -0,0 +1,37 @@
+/*
+ * mm.h - Stand-in for the malloc lab's mm.h, so the tools in this directory
+ *        build without the lab handout. Build with -I. from here. It also
+ *        declares mm_deinit, mm_heap_bounds and the movable allocation
+ *        functions this mm.c adds, which the handout's own file lacks.
+ */
+#ifndef MM_H
+#define MM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+extern int mm_init(void);
+extern void *mm_malloc(size_t size);
+extern void mm_free(void *ptr);
+extern void *mm_realloc(void *ptr, size_t size);
+extern void mm_deinit(void); // before mem_reset_brk or mem_deinit
+extern void mm_heap_bounds(void **lo, void **hi);
+
+// Movable allocations: see mm_halloc in mm.c
+typedef uint32_t handle_t;
+extern handle_t mm_halloc(size_t size);
+extern void *mm_hderef(handle_t handle);
+extern void mm_hfree(handle_t handle);
+extern size_t mm_compact(size_t max_moves, size_t max_blocks);
+extern void mm_trim(void);
+
+// Author details, filled in at the top of mm.c
+typedef struct {
+  char *name;    /* first and last name */
+  char *uid;     /* UID */
+  char *message; /* custom message (16 chars) */
+} team_t;
+
+extern team_t team;
+
+#endif
@@ -0,0 +1,472 @@
+/*
+ * mm_bench.c - Per-call latency of mm_malloc, mm_free and mm_realloc over an
+ *              allocation trace, reported as percentiles.
+ *
+ * The trace is either a malloc lab trace file (four header lines, then one
+ * "a id size", "f id" or "r id size" line per call) or, by default, a
+ * synthetic one: random allocations and frees over a large set of slots, so
+ * the heap stays big and fragmented and the free lists are long and mostly out
+ * of cache. Each call is timed on its own with the time stamp counter (or
+ * clock_gettime off x86), so every figure includes the same timer overhead;
+ * they are meant for comparing builds of mm.c, as prefetch_sweep.sh does for
+ * PREFETCH_DISTANCE.
+ *
+ * Output is CSV in timer ticks: percentiles, one row per kind of call, or with
+ * -H a histogram with power-of-two buckets, one row per nonempty bucket, which
+ * shows the shape of the tail (tail_histogram.sh compares builds with it).
+ *
+ * With -A it ages a heap of movable blocks instead: AGED_ROUNDS rounds of
+ * filling AGED_HANDLES slots through mm_halloc and freeing a random half, then
+ * mm_compact until nothing moves, then mm_trim. After each stage it prints the
+ * live payload, the heap size, how much of the heap is resident (mincore),
+ * utilization (live payload over resident heap) and the process RSS, and it
+ * checks that every payload survived the moves.
+ *
+ * Build: gcc -O2 -I. -o mm_bench mm_bench.c ../mm.c memlib.c -lpthread
+ * Usage: mm_bench [-H] [-l label] [-r repeats] [-s seed] [trace]
+ *        mm_bench -A [-l label] [-s seed]
+ */
+#include "memlib.h"
+#include "mm.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define SYNTH_SLOTS (1 << 16) /* live objects the synthetic trace juggles */
+#define SYNTH_OPS (1 << 21)   /* calls in the synthetic trace */
+#define AGED_HANDLES 20000    /* movable blocks the aged heap juggles */
+#define AGED_ROUNDS 4         /* fill and free-half rounds before compaction */
+
+enum op_kind { OP_ALLOC, OP_FREE, OP_REALLOC, OP_KINDS };
+
+static const char *const OP_NAMES[OP_KINDS] = {"malloc", "free", "realloc"};
+
+typedef struct {
+  enum op_kind kind;
+  uint32_t id;
+  uint32_t size;
+} op_t;
+
+typedef struct {
+  op_t *ops;
+  size_t num_ops;
+  uint32_t num_ids;
+} trace_t;
+
+// Time stamp in ticks
+static inline uint64_t ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+#endif
+}
+
+// xorshift64*, so traces are the same on every run with the same seed
+static uint64_t next_random(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Mostly small requests with a long tail, roughly what real programs ask for
+static uint32_t random_size(uint64_t *state) {
+  uint64_t r = next_random(state);
+  uint32_t bucket = (uint32_t)(r % 100);
+  uint32_t jitter = (uint32_t)(r >> 32);
+
+  if (bucket < 70) {
+    return 8 + jitter % 120;
+  }
+  if (bucket < 95) {
+    return 128 + jitter % 896;
+  }
+  return 1024 + jitter % 7168;
+}
+
+/*
+ * synth_trace - Pick a random slot per call: allocate it if it is empty,
+ *     otherwise free it or, now and then, resize it
+ */
+static trace_t synth_trace(uint64_t seed) {
+  trace_t trace = {malloc(sizeof(op_t) * SYNTH_OPS), SYNTH_OPS, SYNTH_SLOTS};
+  uint8_t *live = calloc(SYNTH_SLOTS, 1);
+  uint64_t state = seed | 1;
+
+  for (size_t i = 0; i < SYNTH_OPS; i++) {
+    uint32_t id = (uint32_t)(next_random(&state) % SYNTH_SLOTS);
+    op_t *op = &trace.ops[i];
+
+    op->id = id;
+    if (!live[id]) {
+      op->kind = OP_ALLOC;
+      op->size = random_size(&state);
+      live[id] = 1;
+    } else if (next_random(&state) % 8 == 0) {
+      op->kind = OP_REALLOC;
+      op->size = random_size(&state);
+    } else {
+      op->kind = OP_FREE;
+      op->size = 0;
+      live[id] = 0;
+    }
+  }
+
+  free(live);
+  return trace;
+}
+
+/*
+ * read_trace - Load a malloc lab trace: heap size hint, number of ids, number
+ *     of calls and weight, then the calls. Exits on a malformed file.
+ */
+static trace_t read_trace(const char *path) {
+  trace_t trace = {NULL, 0, 0};
+  FILE *file = fopen(path, "r");
+  unsigned hint = 0;
+  unsigned num_ids = 0;
+  unsigned num_ops = 0;
+  unsigned weight = 0;
+
+  if (file == NULL) {
+    perror(path);
+    exit(1);
+  }
+  if (fscanf(file, "%u %u %u %u", &hint, &num_ids, &num_ops, &weight) != 4) {
+    fprintf(stderr, "%s: bad trace header\n", path);
+    exit(1);
+  }
+
+  trace.ops = malloc(sizeof(op_t) * (num_ops + 1));
+  trace.num_ids = num_ids;
+
+  char kind = 0;
+  while (trace.num_ops < num_ops && fscanf(file, " %c", &kind) == 1) {
+    op_t *op = &trace.ops[trace.num_ops];
+    int fields = 0;
+
+    op->size = 0;
+    switch (kind) {
+    case 'a':
+      op->kind = OP_ALLOC;
+      fields = fscanf(file, "%u %u", &op->id, &op->size) - 2;
+      break;
+    case 'r':
+      op->kind = OP_REALLOC;
+      fields = fscanf(file, "%u %u", &op->id, &op->size) - 2;
+      break;
+    case 'f':
+      op->kind = OP_FREE;
+      fields = fscanf(file, "%u", &op->id) - 1;
+      break;
+    default:
+      fields = -1;
+      break;
+    }
+    if (fields != 0 || op->id >= num_ids) {
+      fprintf(stderr, "%s: bad call %zu\n", path, trace.num_ops + 1);
+      exit(1);
+    }
+    trace.num_ops++;
+  }
+
+  fclose(file);
+  return trace;
+}
+
+/*
+ * run_trace - Replay the trace on a fresh heap, appending the duration of each
+ *     call to samples[kind]. Exits if the allocator runs out of memory.
+ */
+static void run_trace(const trace_t *trace, uint32_t **samples,
+                      size_t *num_samples) {
+  void **ptrs = calloc(trace->num_ids, sizeof(void *));
+
+  mem_reset_brk();
+  if (mm_init() < 0) {
+    fprintf(stderr, "mm_init failed\n");
+    exit(1);
+  }
+
+  for (size_t i = 0; i < trace->num_ops; i++) {
+    const op_t *op = &trace->ops[i];
+    bool ok = true;
+    uint64_t start = ticks();
+
+    switch (op->kind) {
+    case OP_ALLOC:
+      ok = (ptrs[op->id] = mm_malloc(op->size)) != NULL;
+      break;
+    case OP_REALLOC:
+      ok = (ptrs[op->id] = mm_realloc(ptrs[op->id], op->size)) != NULL;
+      break;
+    default:
+      mm_free(ptrs[op->id]);
+      ptrs[op->id] = NULL;
+      break;
+    }
+
+    uint64_t elapsed = ticks() - start;
+    if (!ok) {
+      fprintf(stderr, "out of memory at call %zu\n", i + 1);
+      exit(1);
+    }
+    samples[op->kind][num_samples[op->kind]++] =
+        (elapsed > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed;
+  }
+
+  // Stop the refill thread before the next run resets the heap under it
+  mm_deinit();
+  free(ptrs);
+}
+
+// Process resident set size in bytes
+static size_t rss_bytes(void) {
+  FILE *file = fopen("/proc/self/statm", "r");
+  unsigned long pages = 0;
+  unsigned long resident = 0;
+
+  if (file == NULL) {
+    return 0;
+  }
+  if (fscanf(file, "%lu %lu", &pages, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(file);
+  return resident * mem_pagesize();
+}
+
+// Bytes of the heap backed by resident pages
+static size_t resident_heap_bytes(void) {
+  const uintptr_t page_size = mem_pagesize();
+  uintptr_t start = (uintptr_t)mem_heap_lo() & ~(page_size - 1);
+  uintptr_t end = (uintptr_t)mem_heap_lo() + mem_heapsize();
+  size_t pages = (end - start + page_size - 1) / page_size;
+  unsigned char *resident = malloc(pages + 1);
+  size_t count = 0;
+
+  if (resident != NULL &&
+      mincore((void *)start, pages * page_size, resident) == 0) {
+    for (size_t i = 0; i < pages; i++) {
+      count += resident[i] & 1;
+    }
+  }
+  free(resident);
+  return count * page_size;
+}
+
+static void print_aged_stage(const char *label, const char *stage,
+                             size_t live, size_t moves) {
+  size_t resident = resident_heap_bytes();
+
+  printf("%s,%s,%zu,%zu,%zu,%.3f,%zu,%zu\n", label, stage, live / 1024,
+         mem_heapsize() / 1024, resident / 1024,
+         (resident == 0) ? 0.0 : (double)live / (double)resident,
+         rss_bytes() / 1024, moves);
+}
+
+/*
+ * run_aged - Age a heap of movable blocks, then compact and trim it, printing
+ *     the footprint after each stage. Exits if a payload is corrupted.
+ */
+static void run_aged(const char *label, uint64_t seed) {
+  handle_t *handles = calloc(AGED_HANDLES, sizeof(handle_t));
+  uint32_t *sizes = calloc(AGED_HANDLES, sizeof(uint32_t));
+  uint64_t state = seed | 1;
+  size_t live = 0;
+  size_t moves = 0;
+  size_t moved = 0;
+
+  mem_reset_brk();
+  if (mm_init() < 0) {
+    fprintf(stderr, "mm_init failed\n");
+    exit(1);
+  }
+
+  for (int round = 0; round < AGED_ROUNDS; round++) {
+    for (size_t i = 0; i < AGED_HANDLES; i++) {
+      if (handles[i] != 0) {
+        continue;
+      }
+      sizes[i] = random_size(&state);
+      handles[i] = mm_halloc(sizes[i]);
+      if (handles[i] == 0) {
+        fprintf(stderr, "out of memory in round %d\n", round);
+        exit(1);
+      }
+      // Each payload is filled with the low byte of its slot number
+      memset(mm_hderef(handles[i]), (int)(i & 0xFF), sizes[i]);
+      live += sizes[i];
+    }
+    for (size_t i = 0; i < AGED_HANDLES; i++) {
+      if (next_random(&state) % 2 == 0) {
+        mm_hfree(handles[i]);
+        handles[i] = 0;
+        live -= sizes[i];
+      }
+    }
+  }
+
+  printf("build,stage,live_kb,heap_kb,resident_kb,utilization,rss_kb,moves\n");
+  print_aged_stage(label, "aged", live, 0);
+
+  // Calls are bounded, and one that visits every block without moving any
+  // means the live blocks are packed as far down as the pinned ones allow
+  while ((moved = mm_compact(AGED_HANDLES, 4 * AGED_HANDLES)) > 0) {
+    moves += moved;
+  }
+  print_aged_stage(label, "compacted", live, moves);
+  mm_trim();
+  print_aged_stage(label, "trimmed", live, moves);
+
+  for (size_t i = 0; i < AGED_HANDLES; i++) {
+    if (handles[i] == 0) {
+      continue;
+    }
+    const unsigned char *payload = mm_hderef(handles[i]);
+    for (uint32_t b = 0; b < sizes[i]; b++) {
+      if (payload[b] != (unsigned char)i) {
+        fprintf(stderr, "slot %zu: byte %u changed after compaction\n", i, b);
+        exit(1);
+      }
+    }
+  }
+
+  mm_deinit();
+  free(handles);
+  free(sizes);
+}
+
+static int compare_samples(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static uint32_t percentile(const uint32_t *sorted, size_t n, double p) {
+  size_t rank = (size_t)(p / 100.0 * (double)n);
+  return sorted[(rank < n) ? rank : n - 1];
+}
+
+static void print_percentiles(const char *label, enum op_kind kind,
+                              const uint32_t *sorted, size_t n) {
+  uint64_t total = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    total += sorted[i];
+  }
+  printf("%s,%s,%zu,%.1f,%u,%u,%u,%u,%u\n", label, OP_NAMES[kind], n,
+         (double)total / (double)n, percentile(sorted, n, 50),
+         percentile(sorted, n, 90), percentile(sorted, n, 99),
+         percentile(sorted, n, 99.9), sorted[n - 1]);
+}
+
+// Bucket b holds durations in [2^b, 2^(b+1)), with 0 in bucket 0; the last
+// column is the share of calls at or below the bucket
+static void print_histogram(const char *label, enum op_kind kind,
+                            const uint32_t *sorted, size_t n) {
+  size_t i = 0;
+
+  while (i < n) {
+    unsigned bucket = (sorted[i] < 2) ? 0 : 31 - __builtin_clz(sorted[i]);
+    unsigned long long upper = 2ULL << bucket;
+    size_t start = i;
+
+    while (i < n && sorted[i] < upper) {
+      i++;
+    }
+    printf("%s,%s,%llu,%llu,%zu,%.5f\n", label, OP_NAMES[kind],
+           (bucket == 0) ? 0ULL : upper / 2, upper - 1, i - start,
+           (double)i / (double)n);
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *label = "mm.c";
+  bool aged = false;
+  bool histogram = false;
+  unsigned repeats = 3;
+  uint64_t seed = 1;
+  int opt = 0;
+
+  while ((opt = getopt(argc, argv, "AHl:r:s:")) != -1) {
+    switch (opt) {
+    case 'A':
+      aged = true;
+      break;
+    case 'H':
+      histogram = true;
+      break;
+    case 'l':
+      label = optarg;
+      break;
+    case 'r':
+      repeats = (unsigned)strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-H] [-l label] [-r repeats] [-s seed] [trace]\n"
+              "       %s -A [-l label] [-s seed]\n",
+              argv[0], argv[0]);
+      return 2;
+    }
+  }
+
+  if (aged) {
+    mem_init();
+    run_aged(label, seed);
+    mem_deinit();
+    return 0;
+  }
+
+  trace_t trace =
+      (optind < argc) ? read_trace(argv[optind]) : synth_trace(seed);
+  uint32_t *samples[OP_KINDS];
+  size_t num_samples[OP_KINDS] = {0};
+
+  for (int kind = 0; kind < OP_KINDS; kind++) {
+    samples[kind] = malloc(sizeof(uint32_t) * trace.num_ops * repeats + 1);
+  }
+
+  mem_init();
+  for (unsigned r = 0; r < repeats; r++) {
+    run_trace(&trace, samples, num_samples);
+  }
+
+  printf(histogram ? "build,call,ticks_from,ticks_to,count,cumulative\n"
+                   : "build,call,count,mean,p50,p90,p99,p99.9,max\n");
+  for (int kind = 0; kind < OP_KINDS; kind++) {
+    size_t n = num_samples[kind];
+
+    if (n > 0) {
+      qsort(samples[kind], n, sizeof(uint32_t), compare_samples);
+      if (histogram) {
+        print_histogram(label, kind, samples[kind], n);
+      } else {
+        print_percentiles(label, kind, samples[kind], n);
+      }
+    }
+    free(samples[kind]);
+  }
+
+  mem_deinit();
+  free(trace.ops);
+  return 0;
+}
@@ -0,0 +1,459 @@
+/*
+ * mm_fuzz.c - Differential fuzzer for mm.c. An input is decoded into a
+ *             sequence of mm_malloc, mm_free, mm_realloc, mm_halloc,
+ *             mm_hfree, mm_compact and mm_trim calls, and each call is checked
+ *             against a shadow model of the live blocks:
+ *
+ *   - payloads are 8-byte aligned, inside the heap, and overlap no other live
+ *     payload
+ *   - every payload keeps the bytes written to it, across mm_realloc (up to
+ *     the smaller size) and across moves made by mm_compact, and a movable
+ *     block registered with mm_set_root is still what mm_get_root returns
+ *   - mm_checkheap reports nothing, checked every CHECK_INTERVAL calls and
+ *     at the end of the input
+ *
+ * Any failure aborts, so the fuzzer or the runner below records the input.
+ *
+ * Built with -DMM_FUZZ_LIBFUZZER only LLVMFuzzerTestOneInput is defined, for
+ * libFuzzer or AFL++ (clang -fsanitize=fuzzer, or afl-clang-fast with
+ * -fsanitize=fuzzer). Otherwise main is a standalone runner. With file
+ * arguments it replays them, like a libFuzzer crash or an AFL @@ input.
+ * Without, it forks one worker per core (or -j), and the workers fuzz random
+ * inputs derived from consecutive seeds until -n inputs have run. The seed of
+ * a failing input is printed; -s seed -n 1 reruns exactly that input.
+ *
+ * mm.c is included directly, so mm_checkheap (static) can be called and its
+ * printf output counted.
+ *
+ * Fuzz with both gcc builds below. The second runs the refill thread under
+ * ThreadSanitizer, which catches any heap access made without heap_lock.
+ *
+ * Build: gcc -O1 -g -fsanitize=address,undefined -I. -o mm_fuzz mm_fuzz.c
+ *            memlib.c -lpthread
+ *        gcc -O1 -g -fsanitize=thread -DBACKGROUND_REFILL -I.
+ *            -o mm_fuzz_tsan mm_fuzz.c memlib.c -lpthread
+ *        clang -O1 -g -fsanitize=fuzzer,address -DMM_FUZZ_LIBFUZZER -I.
+ *            -o mm_fuzz mm_fuzz.c memlib.c -lpthread
+ * Usage: mm_fuzz [-j jobs] [-n inputs] [-s seed] [file...]
+ */
+#include <stdarg.h>
+#include <stdio.h>
+
+// mm_checkheap only reports through printf; count the reports that are
+// errors, which start with "Error" or "Bad"
+static int heap_report(const char *format, ...);
+#define printf heap_report
+#include "../mm.c"
+#undef printf
+
+#include <signal.h>
+#include <sys/wait.h>
+
+#define SLOTS 256          /* blocks the model tracks at once */
+#define MAX_CALLS 4096     /* calls decoded from one input */
+#define CHECK_INTERVAL 16  /* calls between mm_checkheap runs */
+#define RANDOM_INPUT 16384 /* longest random input, in bytes */
+
+enum slot_kind { SLOT_EMPTY, SLOT_PINNED, SLOT_MOVABLE };
+
+typedef struct {
+  enum slot_kind kind;
+  unsigned char *payload; // SLOT_PINNED only
+  handle_t handle;        // SLOT_MOVABLE only
+  size_t size;
+  uint8_t tag; // payload byte i is tag + i
+} slot_t;
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+static slot_t slots[SLOTS];
+static int heap_errors; // error lines printed by mm_checkheap
+static bool heap_ready; // mem_init has run
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+static int heap_report(const char *format, ...) {
+  va_list args;
+
+  if (strncmp(format, "Error", 5) == 0 || strncmp(format, "Bad", 3) == 0) {
+    heap_errors++;
+  }
+  va_start(args, format);
+  int result = vprintf(format, args);
+  va_end(args);
+  return result;
+}
+
+// Prints what went wrong and aborts, which is what fuzzers treat as a crash
+static void fail(const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  fprintf(stderr, "mm_fuzz: ");
+  vfprintf(stderr, format, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+  fflush(stdout);
+  abort();
+}
+
+static unsigned char *slot_payload(const slot_t *slot) {
+  return (slot->kind == SLOT_MOVABLE) ? mm_hderef(slot->handle)
+                                      : slot->payload;
+}
+
+static void fill_slot(slot_t *slot) {
+  unsigned char *payload = slot_payload(slot);
+  for (size_t i = 0; i < slot->size; i++) {
+    payload[i] = (unsigned char)(slot->tag + i);
+  }
+}
+
+static void check_payload(int index, size_t size) {
+  const slot_t *slot = &slots[index];
+  const unsigned char *payload = slot_payload(slot);
+
+  for (size_t i = 0; i < size; i++) {
+    if (payload[i] != (unsigned char)(slot->tag + i)) {
+      fail("slot %d: byte %zu of %zu at %p was overwritten", index, i,
+           slot->size, (void *)payload);
+    }
+  }
+}
+
+/*
+ * check_placement - A new or moved payload must be aligned, inside the heap
+ *     and clear of every other live payload
+ */
+static void check_placement(int index) {
+  const slot_t *slot = &slots[index];
+  uintptr_t start = (uintptr_t)slot_payload(slot);
+  uintptr_t end = start + slot->size;
+  void *heap_lo = NULL;
+  void *heap_hi = NULL;
+
+  // Not mem_heap_hi, which races with the refill thread growing the heap
+  mm_heap_bounds(&heap_lo, &heap_hi);
+  if (start % 8 != 0) {
+    fail("slot %d: payload %p is not 8-byte aligned", index, (void *)start);
+  }
+  if (start < (uintptr_t)heap_lo || end > (uintptr_t)heap_hi + 1) {
+    fail("slot %d: payload %p (%zu bytes) is outside the heap", index,
+         (void *)start, slot->size);
+  }
+
+  for (int other = 0; other < SLOTS; other++) {
+    if (other == index || slots[other].kind == SLOT_EMPTY) {
+      continue;
+    }
+    uintptr_t other_start = (uintptr_t)slot_payload(&slots[other]);
+    uintptr_t other_end = other_start + slots[other].size;
+    if (start < other_end && other_start < end) {
+      fail("slot %d (%p, %zu bytes) overlaps slot %d (%p, %zu bytes)", index,
+           (void *)start, slot->size, other, (void *)other_start,
+           slots[other].size);
+    }
+  }
+}
+
+static void check_heap(void) {
+  heap_errors = 0;
+  mm_checkheap(0);
+  if (heap_errors > 0) {
+    fail("mm_checkheap reported %d errors", heap_errors);
+  }
+}
+
+static void release_slot(int index) {
+  slot_t *slot = &slots[index];
+
+  check_payload(index, slot->size);
+  if (slot->kind == SLOT_MOVABLE) {
+    mm_hfree(slot->handle);
+  } else {
+    mm_free(slot->payload);
+  }
+  slot->kind = SLOT_EMPTY;
+}
+
+/*
+ * run_call - Decode and run one call from 4 input bytes: the call, the slot
+ *     and a 16-bit size. The call byte's top four bits shift the size right
+ *     by 0 to 15, so small requests are common but blocks larger than
+ *     CHUNKSIZE still show up.
+ */
+static void run_call(const uint8_t *bytes, uint8_t tag) {
+  int index = bytes[1] % SLOTS;
+  slot_t *slot = &slots[index];
+  size_t size = (size_t)bytes[2] | ((size_t)bytes[3] << 8);
+
+  size >>= bytes[0] >> 4;
+
+  switch (bytes[0] % 8) {
+  case 0:
+  case 1:
+  case 2: // allocate, or free what the slot holds
+    if (slot->kind != SLOT_EMPTY) {
+      release_slot(index);
+      break;
+    }
+    slot->payload = mm_malloc(size);
+    if (slot->payload == NULL) {
+      if (size > 0) {
+        fail("mm_malloc(%zu) failed", size);
+      }
+      break;
+    }
+    *slot = (slot_t){SLOT_PINNED, slot->payload, NULL_HANDLE, size, tag};
+    check_placement(index);
+    fill_slot(slot);
+    break;
+
+  case 3:
+  case 4: { // resize a pinned block; mm_realloc(NULL, size) allocates
+    if (slot->kind == SLOT_MOVABLE) {
+      release_slot(index);
+      break;
+    }
+    size_t kept = (slot->kind == SLOT_PINNED) ? slot->size : 0;
+    if (size < kept) {
+      kept = size;
+    }
+    check_payload(index, kept);
+    unsigned char *payload =
+        mm_realloc((slot->kind == SLOT_PINNED) ? slot->payload : NULL, size);
+    if (payload == NULL) {
+      if (size > 0) {
+        fail("mm_realloc to %zu bytes failed", size);
+      }
+      slot->kind = SLOT_EMPTY;
+      break;
+    }
+    slot->kind = SLOT_PINNED;
+    slot->payload = payload;
+    slot->size = size;
+    check_payload(index, kept);
+    check_placement(index);
+    // The new tail continues the same byte pattern
+    for (size_t i = kept; i < size; i++) {
+      payload[i] = (unsigned char)(slot->tag + i);
+    }
+    break;
+  }
+
+  case 5: // allocate a movable block, or free what the slot holds
+    if (slot->kind != SLOT_EMPTY) {
+      release_slot(index);
+      break;
+    }
+    if (size == 0) {
+      size = 1;
+    }
+    slot->handle = mm_halloc(size);
+    if (slot->handle == NULL_HANDLE) {
+      fail("mm_halloc(%zu) failed", size);
+    }
+    slot->kind = SLOT_MOVABLE;
+    slot->size = size;
+    slot->tag = tag;
+    check_placement(index);
+    fill_slot(slot);
+    break;
+
+  case 6: // compact a little; every movable block must survive the moves
+    // A movable root must follow its block
+    if (slot->kind == SLOT_MOVABLE) {
+      mm_set_root(slot_payload(slot));
+    }
+    mm_compact(bytes[2] % 16, bytes[3]);
+    for (int i = 0; i < SLOTS; i++) {
+      if (slots[i].kind == SLOT_MOVABLE) {
+        check_payload(i, slots[i].size);
+        check_placement(i);
+      }
+    }
+    if (slot->kind == SLOT_MOVABLE && mm_get_root() != slot_payload(slot)) {
+      fail("slot %d: root %p does not follow the block to %p", index,
+           mm_get_root(), (void *)slot_payload(slot));
+    }
+    break;
+
+  default:
+    mm_trim();
+    break;
+  }
+}
+
+/*
+ * run_input - Replay one input on a fresh heap
+ */
+static void run_input(const uint8_t *data, size_t size) {
+  if (!heap_ready) {
+    mem_init();
+    heap_ready = true;
+  }
+  mem_reset_brk();
+  if (mm_init() < 0) {
+    fail("mm_init failed");
+  }
+  memset(slots, 0, sizeof(slots));
+
+  size_t calls = size / 4;
+  if (calls > MAX_CALLS) {
+    calls = MAX_CALLS;
+  }
+  for (size_t i = 0; i < calls; i++) {
+    run_call(data + 4 * i, (uint8_t)i);
+    if (i % CHECK_INTERVAL == CHECK_INTERVAL - 1) {
+      check_heap();
+    }
+  }
+
+  for (int i = 0; i < SLOTS; i++) {
+    if (slots[i].kind != SLOT_EMPTY) {
+      check_payload(i, slots[i].size);
+    }
+  }
+  check_heap();
+  // Stop the refill thread before the next input resets the heap under it
+  mm_deinit();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  run_input(data, size);
+  return 0;
+}
+
+#ifndef MM_FUZZ_LIBFUZZER
+
+// splitmix64, so each input is a pure function of its seed
+static uint64_t next_random(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static size_t random_input(uint64_t seed, uint8_t *data) {
+  uint64_t state = seed;
+  size_t size = 4 + next_random(&state) % (RANDOM_INPUT - 3);
+
+  for (size_t i = 0; i < size; i += 8) {
+    uint64_t word = next_random(&state);
+    memcpy(data + i, &word, (size - i < 8) ? size - i : 8);
+  }
+  return size;
+}
+
+static int replay_file(const char *path) {
+  static uint8_t data[4 * MAX_CALLS];
+  FILE *file = fopen(path, "rb");
+
+  if (file == NULL) {
+    perror(path);
+    return 1;
+  }
+  size_t size = fread(data, 1, sizeof(data), file);
+  fclose(file);
+  run_input(data, size);
+  printf("%s: ok\n", path);
+  return 0;
+}
+
+/*
+ * run_worker - Fuzz the inputs for seeds first, first + stride, ... below
+ *     end. The seed in progress is kept in *current for the parent to report.
+ */
+static void run_worker(uint64_t first, uint64_t end, uint64_t stride,
+                       volatile uint64_t *current) {
+  static uint8_t data[RANDOM_INPUT];
+
+  for (uint64_t seed = first; seed < end; seed += stride) {
+    *current = seed;
+    run_input(data, random_input(seed, data));
+  }
+}
+
+int main(int argc, char **argv) {
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  uint64_t inputs = 10000;
+  uint64_t seed = 1;
+  int opt = 0;
+
+  while ((opt = getopt(argc, argv, "j:n:s:")) != -1) {
+    switch (opt) {
+    case 'j':
+      jobs = strtol(optarg, NULL, 0);
+      break;
+    case 'n':
+      inputs = strtoull(optarg, NULL, 0);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-j jobs] [-n inputs] [-s seed] [file...]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  if (optind < argc) {
+    int status = 0;
+    for (int i = optind; i < argc; i++) {
+      status |= replay_file(argv[i]);
+    }
+    return status;
+  }
+
+  if (jobs < 1) {
+    jobs = 1;
+  }
+
+  // One process per worker, since the allocator's state is global. Each
+  // publishes its seed in progress through a shared page.
+  volatile uint64_t *current =
+      mmap(NULL, sizeof(uint64_t) * (size_t)jobs, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (current == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+
+  pid_t *workers = calloc((size_t)jobs, sizeof(pid_t));
+  for (long i = 0; i < jobs; i++) {
+    workers[i] = fork();
+    if (workers[i] == 0) {
+      run_worker(seed + (uint64_t)i, seed + inputs, (uint64_t)jobs,
+                 &current[i]);
+      _exit(0);
+    }
+    if (workers[i] < 0) {
+      perror("fork");
+      return 1;
+    }
+  }
+
+  int failures = 0;
+  for (long i = 0; i < jobs; i++) {
+    int status = 0;
+    waitpid(workers[i], &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "worker %ld failed on seed %llu (%s); rerun with -s %llu "
+                      "-n 1 -j 1\n",
+              i, (unsigned long long)current[i],
+              WIFSIGNALED(status) ? strsignal(WTERMSIG(status)) : "exit",
+              (unsigned long long)current[i]);
+      failures++;
+    }
+  }
+
+  if (failures == 0) {
+    printf("%llu inputs ok across %ld workers\n", (unsigned long long)inputs,
+           jobs);
+  }
+  free(workers);
+  return failures > 0;
+}
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * mm_persist.c - Reopen test for the file-backed heap. A new heap file is
+ *                filled with a linked list whose links are stored as offsets
+ *                from the root object, with freed blocks in between so the
+ *                free lists are not empty. The heap is then closed and opened
+ *                again while its old address range is held by another
+ *                mapping, so it has to come back at a different base. The list
+ *                must read back the same from mm_get_root, mm_checkheap must
+ *                report nothing, and the reopened heap must keep working
+ *                through another round of frees and allocations.
+ *
+ * mm.c is included directly, so mm_checkheap (static) can be called and its
+ * printf output counted.
+ *
+ * Build: gcc -O1 -g -fsanitize=address,undefined -I. -o mm_persist
+ *            mm_persist.c memlib.c -lpthread
+ * Usage: mm_persist [-n nodes] [file]
+ * Without a file, a temporary one is created and removed at the end.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+
+// mm_checkheap only reports through printf; count the reports that are
+// errors, which start with "Error" or "Bad"
+static int heap_report(const char *format, ...);
+#define printf heap_report
+#include "../mm.c"
+#undef printf
+
+#define HEAP_FILE_SIZE (1 << 24) /* bytes the heap file is sized to */
+#define FILLER_SIZE 200          /* payload of the blocks freed in between */
+
+// A list node. next is the offset of the next node from the root node (the
+// first one), or 0 at the end, so the list does not depend on where the heap
+// is mapped.
+typedef struct {
+  uint64_t next;
+  uint32_t value;
+  uint32_t check; // ~value, so a node overwritten by the allocator shows
+} node_t;
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static int heap_errors; // error lines printed by mm_checkheap
+
+static int heap_report(const char *format, ...) {
+  va_list args;
+
+  if (strncmp(format, "Error", 5) == 0 || strncmp(format, "Bad", 3) == 0) {
+    heap_errors++;
+  }
+  va_start(args, format);
+  int result = vprintf(format, args);
+  va_end(args);
+  return result;
+}
+
+static bool heap_ok(const char *when) {
+  heap_errors = 0;
+  mm_checkheap(0);
+  if (heap_errors > 0) {
+    fprintf(stderr, "%s: mm_checkheap reported %d errors\n", when,
+            heap_errors);
+    return false;
+  }
+  return true;
+}
+
+static node_t *node_at(node_t *root, uint64_t offset) {
+  return (offset == 0) ? NULL : (node_t *)((char *)root + offset);
+}
+
+/*
+ * build_list - Allocate nodes with values 0..nodes-1, each followed by a
+ *     filler block that is freed again, and register the first as the root
+ */
+static bool build_list(uint32_t nodes) {
+  node_t *root = NULL;
+  node_t *last = NULL;
+
+  for (uint32_t i = 0; i < nodes; i++) {
+    node_t *node = mm_malloc(sizeof(node_t));
+    void *filler = mm_malloc(FILLER_SIZE + (i % 8) * 64);
+    if (node == NULL || filler == NULL) {
+      fprintf(stderr, "out of memory at node %u\n", i);
+      return false;
+    }
+
+    *node = (node_t){0, i, ~i};
+    if (root == NULL) {
+      root = node;
+      mm_set_root(root);
+    } else {
+      last->next = (uint64_t)((char *)node - (char *)root);
+    }
+    last = node;
+    // Every other filler is freed, leaving holes on the free lists
+    if (i % 2 == 0) {
+      mm_free(filler);
+    }
+  }
+  return true;
+}
+
+// Walks the list from the root, checking that node i holds i * stride. Returns
+// the length, or -1 if a node is wrong.
+static long walk_list(uint32_t nodes, uint32_t stride) {
+  node_t *root = mm_get_root();
+  long length = 0;
+
+  for (node_t *node = root; node != NULL; node = node_at(root, node->next)) {
+    uint32_t want = (uint32_t)length * stride;
+    if (length >= (long)nodes || node->value != want ||
+        node->check != ~want) {
+      fprintf(stderr, "node %ld at %p: value %u, check 0x%x\n", length,
+              (void *)node, node->value, node->check);
+      return -1;
+    }
+    length++;
+  }
+  return length;
+}
+
+/*
+ * churn - Free every other node of the reopened heap (relinking the list
+ *     around them) and allocate as many new blocks, so the free lists
+ *     restored from the file are used
+ */
+static bool churn(void) {
+  node_t *root = mm_get_root();
+
+  for (node_t *node = root; node != NULL; node = node_at(root, node->next)) {
+    node_t *doomed = node_at(root, node->next);
+    if (doomed == NULL) {
+      break;
+    }
+    node->next = doomed->next;
+    mm_free(doomed);
+    if (mm_malloc(FILLER_SIZE) == NULL) {
+      fprintf(stderr, "out of memory after reopening\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  char temp_path[] = "/tmp/mm_persist.XXXXXX";
+  const char *path = temp_path;
+  uint32_t nodes = 10000;
+  int opt = 0;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+    case 'n':
+      nodes = (uint32_t)strtoul(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-n nodes] [file]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (optind < argc) {
+    path = argv[optind];
+    unlink(path); // start from a new file
+  } else {
+    int fd = mkstemp(temp_path);
+    if (fd < 0) {
+      perror("mkstemp");
+      return 1;
+    }
+    close(fd);
+  }
+
+  bool ok = mm_init_persistent(path, HEAP_FILE_SIZE) == 0;
+  if (!ok) {
+    fprintf(stderr, "%s: cannot create the heap\n", path);
+  }
+  ok = ok && build_list(nodes) && heap_ok("before reopening");
+  void *old_base = heap_mapping;
+  mm_close_persistent();
+
+  // Hold the old range, so the heap has to be mapped somewhere else
+  void *placeholder = mmap(old_base, HEAP_FILE_SIZE, PROT_NONE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ok && mm_init_persistent(path, 0) < 0) {
+    fprintf(stderr, "%s: cannot reopen the heap\n", path);
+    ok = false;
+  }
+  if (ok && heap_mapping == old_base) {
+    fprintf(stderr, "heap came back at the same address %p\n", old_base);
+    ok = false;
+  }
+
+  long length = ok ? walk_list(nodes, 1) : -1;
+  if (ok && length != (long)nodes) {
+    fprintf(stderr, "read back %ld of %u nodes\n", length, nodes);
+    ok = false;
+  }
+  ok = ok && heap_ok("after reopening") && churn() &&
+       walk_list(nodes, 2) == ((long)nodes + 1) / 2 && heap_ok("after churn");
+
+  if (ok) {
+    printf("ok  %u nodes, heap moved from %p to %p\n", nodes, old_base,
+           heap_mapping);
+  }
+  mm_close_persistent();
+  if (placeholder != MAP_FAILED) {
+    munmap(placeholder, HEAP_FILE_SIZE);
+  }
+  unlink(path);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+#!/bin/sh
+# prefetch_sweep.sh - Rebuild mm_bench once per PREFETCH_DISTANCE and replay
+#     the same trace with each build, printing one CSV with all of them.
+#
+# Usage: ./prefetch_sweep.sh [mm_bench arguments...]
+# DISTANCES sets the values tried (default "0 1 2 4 8"), CC and CFLAGS the
+# compiler (default gcc -O2).
+set -e
+cd "$(dirname "$0")"
+
+build_dir=$(mktemp -d)
+trap 'rm -rf "$build_dir"' EXIT
+
+first=1
+for distance in ${DISTANCES:-0 1 2 4 8}; do
+  # shellcheck disable=SC2086 # CFLAGS is a list of flags
+  ${CC:-gcc} ${CFLAGS:--O2} -I. -DPREFETCH_DISTANCE="$distance" \
+    -o "$build_dir/mm_bench" mm_bench.c ../mm.c memlib.c -lpthread
+  if [ "$first" = 1 ]; then
+    "$build_dir/mm_bench" -l "distance=$distance" "$@"
+    first=0
+  else
+    "$build_dir/mm_bench" -l "distance=$distance" "$@" | tail -n +2
+  fi
+done
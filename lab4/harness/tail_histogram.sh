@@ -0,0 +1,31 @@
+#!/bin/sh
+# tail_histogram.sh - Compare the latency histograms of three builds of mm.c on
+#     the same trace: the default unbounded first-fit search, a search bounded
+#     by FIT_BUDGET, and FIT_BUDGET with BACKGROUND_REFILL.
+#
+# Usage: ./tail_histogram.sh [mm_bench arguments...]
+# BUDGET sets the FIT_BUDGET tried (default 16), CC and CFLAGS the compiler
+# (default gcc -O2).
+set -e
+cd "$(dirname "$0")"
+
+build_dir=$(mktemp -d)
+trap 'rm -rf "$build_dir"' EXIT
+
+first=1
+for build in unbounded bounded refill; do
+  case $build in
+  unbounded) flags= ;;
+  bounded) flags=-DFIT_BUDGET=${BUDGET:-16} ;;
+  refill) flags="-DFIT_BUDGET=${BUDGET:-16} -DBACKGROUND_REFILL" ;;
+  esac
+  # shellcheck disable=SC2086 # CFLAGS and flags are lists of flags
+  ${CC:-gcc} ${CFLAGS:--O2} -I. $flags -o "$build_dir/mm_bench" \
+    mm_bench.c ../mm.c memlib.c -lpthread
+  if [ "$first" = 1 ]; then
+    "$build_dir/mm_bench" -H -l "$build" "$@"
+    first=0
+  else
+    "$build_dir/mm_bench" -H -l "$build" "$@" | tail -n +2
+  fi
+done
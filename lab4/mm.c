@@ -6,10 +6,13 @@
  *
  *      63       32   31        1   0
  *      --------------------------------
- *     |   unused   | block_size | a/f |
+ *     |   handle   | block_size | a/f |
  *      --------------------------------
  *
- * a/f is 1 iff the block is allocated. The list has the following form:
+ * a/f is 1 iff the block is allocated. handle is only meaningful in the header
+ * of an allocated block: it is nonzero iff the block was allocated with
+ * mm_halloc, in which case the compactor is allowed to move it. The list has
+ * the following form:
  *
  * begin                                       end
  * heap                                       heap
@@ -21,18 +24,29 @@
  *
  * The allocated prologue and epilogue blocks are overhead that
  * eliminate edge conditions during coalescing.
+ *
+ * The heap starts with a small metadata area (magic, break offset, root
+ * offset) followed by the segregated free list heads. Free list links and
+ * list heads are stored as byte offsets from the start of the heap rather than
+ * as pointers, so a heap can be backed by a file (see mm_init_persistent) and
+ * mapped back in at a different base address.
  */
 #include "mm.h"
 #include "memlib.h"
 #include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 // #define DEBUG_OUTPUT
+// #define BACKGROUND_REFILL
 
 // Your info
 // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
@@ -53,14 +67,18 @@ typedef struct {
 
 typedef header_t footer_t;
 
+// Byte offset from the start of the heap. Offset 0 is the heap metadata, which
+// is never a block, so it doubles as the null offset.
+typedef uint64_t offset_t;
+
 typedef struct block_t {
   uint32_t allocated : 1;
   uint32_t block_size : 31;
-  uint32_t _;
+  uint32_t handle; // handle of a movable block, or NULL_HANDLE if pinned
   union {
     struct {
-      struct block_t *next;
-      struct block_t *prev;
+      offset_t next;
+      offset_t prev;
     };
     int payload[0];
   } body;
@@ -69,7 +87,57 @@ typedef struct block_t {
 /* This enum can be used to set the allocated bit in the block */
 enum block_state { FREE, ALLOC };
 
+// Metadata at the very start of the heap. Everything needed to reopen a
+// file-backed heap is reachable from here.
+typedef struct {
+  uint64_t magic;
+  uint64_t heap_size;   // current break, as an offset from the heap start
+  offset_t root;        // root payload offset, or tagged handle (mm_set_root)
+  offset_t handles;     // payload offset of the handle table
+  uint32_t handle_cap;  // number of entries in the handle table
+  uint32_t handle_free; // first unused handle, or NULL_HANDLE
+  uint64_t free_bytes;  // total size of the blocks on the free lists
+  offset_t compact_at;  // block mm_compact resumes from, or NULL_OFFSET
+} heap_meta_t;
+
+// Handles are 1-based indices into the handle table, so 0 is never a valid
+// handle. A live table entry holds the offset of its block; an unused entry
+// holds the next unused handle, tagged with the low bit (block offsets are
+// always 8-byte aligned).
+typedef uint32_t handle_t;
+
+#define HEAP_MAGIC (0x3270616568737a70ULL) /* "pzsheap2" */
+#define NULL_OFFSET ((offset_t)0)
+#define NULL_HANDLE ((handle_t)0)
+#define HANDLE_TABLE_MIN (64) /* initial number of handle table entries */
+
 #define CHUNKSIZE (1 << 16) /* initial heap size (bytes) */
+
+// How many segregated lists ahead of the one being searched find_fit prefetches
+// the head of. Override with -DPREFETCH_DISTANCE=n; 0 disables software
+// prefetching. harness/prefetch_sweep.sh compares the settings: a search rarely
+// gets past the next list, so heads further ahead are mostly fetched for
+// nothing.
+#ifndef PREFETCH_DISTANCE
+#define PREFETCH_DISTANCE 1
+#endif
+
+// Maximum number of free blocks find_fit inspects before falling back to a list
+// where every block is guaranteed to fit. Unbounded unless built with
+// -DFIT_BUDGET=n; harness/tail_histogram.sh compares the two.
+#ifndef FIT_BUDGET
+#define FIT_BUDGET UINT32_MAX
+#endif
+
+// With BACKGROUND_REFILL, a helper thread extends the heap by CHUNKSIZE
+// whenever the free bytes on the free lists drop below this mark
+#define REFILL_LOW_WATER (4 * CHUNKSIZE)
+
+#if PREFETCH_DISTANCE > 0 && defined(__GNUC__)
+#define PREFETCH(addr) __builtin_prefetch((addr), 1)
+#else
+#define PREFETCH(addr)
+#endif
 #define OVERHEAD                                                               \
   (sizeof(header_t) + sizeof(footer_t)) /* overhead of the header and footer   \
                                            of an allocated block */
@@ -80,17 +148,67 @@ enum block_state { FREE, ALLOC };
 /* Global variables */
 // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
 static block_t *prologue; /* pointer to first block */
-static block_t
+static offset_t
     // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
-    **segregated_lists; // Pointer to explicit free lists on the heap (each list
-                        // is a null-terminated doubly-linked list)
+    *segregated_lists; // Pointer to explicit free list heads on the heap (each
+                       // list is a null-terminated doubly-linked list)
 static const uint32_t LIST_NUM = 128;
 
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static heap_meta_t *heap_meta; // Start of the heap, base for all offsets
+
+// File-backed heap state. heap_fd is -1 when the heap comes from mem_sbrk.
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static int heap_fd = -1;
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static void *heap_mapping; // start of the file mapping
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static size_t heap_capacity; // size of the file mapping
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static size_t heap_brk; // bytes of the heap handed out so far
+
+#ifdef BACKGROUND_REFILL
+// The refill thread shares the heap with callers, so every public entry point
+// holds heap_lock while it touches the heap, and the thread is stopped before
+// the heap is reinitialized or unmapped
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static pthread_cond_t refill_cond = PTHREAD_COND_INITIALIZER;
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static pthread_t refill_thread;
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static bool refill_running; // refill_thread was started and not yet joined
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static bool refill_stop; // asks refill_thread to exit, under heap_lock
+#endif
+
 // Debug variables
 // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
 static int global_counter = 1;
 static const int LIST_DEPTH = 1000;
 
+#ifdef BACKGROUND_REFILL
+
+#define HEAP_LOCK() pthread_mutex_lock(&heap_lock)
+#define HEAP_UNLOCK() pthread_mutex_unlock(&heap_lock)
+#define REFILL_CHECK()                                                         \
+  if (heap_meta->free_bytes < REFILL_LOW_WATER) {                              \
+    pthread_cond_signal(&refill_cond);                                         \
+  }
+#define START_REFILL() start_refill()
+#define STOP_REFILL() stop_refill()
+
+#else
+
+#define HEAP_LOCK()
+#define HEAP_UNLOCK()
+#define REFILL_CHECK()
+#define START_REFILL()
+#define STOP_REFILL()
+
+#endif
+
 #ifndef DEBUG_OUTPUT
 
 #define CHECK_EXPLICIT_LIST(list_depth)
@@ -108,14 +226,52 @@ static const int LIST_DEPTH = 1000;
 #endif
 
 /* function prototypes for internal helper routines */
+// Heap region functions
+static int init_heap(void);
+static int open_heap_file(const char *path, size_t max_size);
+static void *heap_sbrk(int incr);
+static block_t *to_block(offset_t offset);
+static offset_t to_offset(void *ptr);
+
 // Explicit free list functions
-static block_t *which_list(block_t *block);
+static uint32_t list_index(size_t size);
+static uint32_t fit_list_index(size_t size);
+static offset_t *which_list(block_t *block);
 static void list_push(block_t *block);
 static void list_remove(block_t *block);
 
 // Debugging functions
 static void debug_print(const char *message);
 
+#ifdef BACKGROUND_REFILL
+// Background refill functions
+static void start_refill(void);
+static void stop_refill(void);
+static void *refill_main(void *arg);
+#endif
+
+// Stops background work before the heap's memory is reset or released
+void mm_deinit(void);
+void mm_heap_bounds(void **lo, void **hi);
+
+// File-backed heap functions
+int mm_init_persistent(const char *path, size_t max_size);
+void mm_close_persistent(void);
+void mm_set_root(void *payload);
+void *mm_get_root(void);
+
+// Movable allocation functions
+handle_t mm_halloc(size_t size);
+void *mm_hderef(handle_t handle);
+void mm_hfree(handle_t handle);
+size_t mm_compact(size_t max_moves, size_t max_blocks);
+void mm_trim(void);
+static int grow_handle_table(void);
+
+// Unlocked bodies of mm_malloc and mm_free, for callers holding heap_lock
+static void *alloc_payload(size_t size);
+static void free_block(block_t *block);
+
 // Original functions given by instructor
 static void mm_checkheap(int verbose);
 static block_t *extend_heap(size_t words);
@@ -125,25 +281,73 @@ static block_t *coalesce(block_t *block);
 static footer_t *get_footer(block_t *block);
 static void printblock(block_t *block);
 static void checkblock(block_t *block);
+static void checklists(size_t free_blocks, size_t free_bytes);
 
 /*
  * mm_init - Initialize the memory manager
  */
 /* $begin mminit */
 int mm_init(void) {
+  STOP_REFILL();
+  HEAP_LOCK();
+  int result = init_heap();
+  HEAP_UNLOCK();
+
+  if (result == 0) {
+    START_REFILL();
+  }
+  return result;
+}
+/* $end mminit */
+
+/*
+ * mm_deinit - Stop the refill thread and close a file-backed heap. Call it
+ *     before the memory under the heap is reset (mem_reset_brk) or released
+ *     (mem_deinit); the heap is unusable until the next mm_init.
+ */
+void mm_deinit(void) {
+  mm_close_persistent();
+  STOP_REFILL();
+}
+
+/*
+ * init_heap - Lay out an empty heap: metadata, free list heads, prologue, one
+ *     free block and the epilogue
+ */
+static int init_heap(void) {
+  // A file-backed heap is reinitialized from the start of its mapping
+  heap_brk = 0;
+  heap_meta = NULL;
+
+  // Initialize heap metadata, located at the start of the heap
+  heap_meta = heap_sbrk(sizeof(heap_meta_t));
+
+  if (heap_meta == (heap_meta_t *)UINTPTR_MAX) {
+    return -1;
+  }
+
+  heap_meta->magic = 0; // set last, once the heap is complete
+  heap_meta->heap_size = heap_brk;
+  heap_meta->root = NULL_OFFSET;
+  heap_meta->handles = NULL_OFFSET;
+  heap_meta->handle_cap = 0;
+  heap_meta->handle_free = NULL_HANDLE;
+  heap_meta->free_bytes = 0;
+  heap_meta->compact_at = NULL_OFFSET;
+
   // Initialize segregated free lists, located before the heap
-  segregated_lists = mem_sbrk((int)(sizeof(block_t *) * LIST_NUM));
+  segregated_lists = heap_sbrk((int)(sizeof(offset_t) * LIST_NUM));
 
-  if (segregated_lists == (block_t **)UINTPTR_MAX) {
+  if (segregated_lists == (offset_t *)UINTPTR_MAX) {
     return -1;
   }
 
-  for (int i = 0; i < LIST_NUM; i++) {
-    segregated_lists[i] = NULL;
+  for (uint32_t i = 0; i < LIST_NUM; i++) {
+    segregated_lists[i] = NULL_OFFSET;
   }
 
   /* create the initial empty heap */
-  if ((prologue = mem_sbrk(CHUNKSIZE)) == (block_t *)UINTPTR_MAX) {
+  if ((prologue = heap_sbrk(CHUNKSIZE)) == (block_t *)UINTPTR_MAX) {
     return -1;
   }
   /* initialize the prologue */
@@ -166,15 +370,188 @@ int mm_init(void) {
   block_t *epilogue = (void *)init_block + init_block->block_size;
   epilogue->allocated = ALLOC;
   epilogue->block_size = 0;
+
+  heap_meta->magic = HEAP_MAGIC;
   return 0;
 }
-/* $end mminit */
+
+/*
+ * open_heap_file - Map the heap file at path and either lay out a new heap in
+ *     it or recompute the base pointers of the one it holds. Returns 0 on
+ *     success and -1 on error, leaving heap_fd open for mm_close_persistent.
+ */
+static int open_heap_file(const char *path, size_t max_size) {
+  struct stat file_stat;
+
+  heap_fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (heap_fd < 0) {
+    return -1;
+  }
+
+  if (fstat(heap_fd, &file_stat) < 0) {
+    return -1;
+  }
+
+  bool created = file_stat.st_size == 0;
+  if (created && ftruncate(heap_fd, (off_t)max_size) < 0) {
+    return -1;
+  }
+  heap_capacity = created ? max_size : (size_t)file_stat.st_size;
+
+  void *mapping = mmap(NULL, heap_capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       heap_fd, 0);
+  if (mapping == MAP_FAILED) {
+    if (created && ftruncate(heap_fd, 0) < 0) {
+      perror("mm_init_persistent: ftruncate");
+    }
+    return -1;
+  }
+  heap_mapping = mapping;
+
+  // The magic is written last, so a file that was sized but never finished
+  // initializing (init_heap failed or the process died) still reads as zero
+  // and is initialized like a new one
+  if (created || ((heap_meta_t *)heap_mapping)->magic == 0) {
+    if (init_heap() < 0) {
+      // Unmap before truncating, then leave a new file empty again
+      munmap(heap_mapping, heap_capacity);
+      heap_mapping = NULL;
+      if (created && ftruncate(heap_fd, 0) < 0) {
+        perror("mm_init_persistent: ftruncate");
+      }
+      return -1;
+    }
+    return 0;
+  }
+
+  // Reopen an existing heap. Only the base pointers need to be recomputed,
+  // since everything stored inside the heap is an offset.
+  heap_meta = heap_mapping;
+  if (heap_meta->magic != HEAP_MAGIC || heap_meta->heap_size > heap_capacity) {
+    return -1;
+  }
+  heap_brk = heap_meta->heap_size;
+  segregated_lists = (void *)heap_meta + sizeof(heap_meta_t);
+  prologue = (void *)segregated_lists + sizeof(offset_t) * LIST_NUM;
+  return 0;
+}
+
+/*
+ * mm_init_persistent - Initialize the memory manager on a heap backed by the
+ *     file at path. A new (or empty) file is sized to max_size bytes and
+ *     initialized like mm_init, as is a file whose initialization never
+ *     finished; an existing heap file is mapped back in as is, in which case
+ *     max_size is ignored. Returns 0 on success, -1 on error.
+ */
+int mm_init_persistent(const char *path, size_t max_size) {
+  mm_close_persistent();
+  STOP_REFILL(); // the previous heap may have come from mem_sbrk
+
+  HEAP_LOCK();
+  int result = open_heap_file(path, max_size);
+  HEAP_UNLOCK();
+
+  if (result < 0) {
+    mm_close_persistent();
+    return -1;
+  }
+  START_REFILL();
+  return 0;
+}
+
+/*
+ * mm_close_persistent - Stop the refill thread, then flush and unmap a
+ *     file-backed heap. Does nothing if the heap is not file-backed.
+ */
+void mm_close_persistent(void) {
+  if (heap_fd < 0) {
+    return;
+  }
+
+  STOP_REFILL();
+  HEAP_LOCK();
+  if (heap_mapping != NULL) {
+    msync(heap_mapping, heap_capacity, MS_SYNC);
+    munmap(heap_mapping, heap_capacity);
+  }
+  close(heap_fd);
+
+  heap_fd = -1;
+  heap_mapping = NULL;
+  heap_capacity = 0;
+  heap_brk = 0;
+  heap_meta = NULL;
+  segregated_lists = NULL;
+  prologue = NULL;
+  HEAP_UNLOCK();
+}
+
+/*
+ * mm_set_root - Register a payload (or NULL) as the heap's root object, so it
+ *     can be found again after a file-backed heap is reopened. A movable
+ *     payload (from mm_hderef) is registered by its handle, so the root
+ *     follows it when mm_compact moves it.
+ */
+void mm_set_root(void *payload) {
+  HEAP_LOCK();
+  block_t *block = (payload == NULL) ? NULL : payload - sizeof(header_t);
+  if (block == NULL) {
+    heap_meta->root = NULL_OFFSET;
+  } else if (block->handle != NULL_HANDLE) {
+    // Tagged with the low bit like an unused handle table entry, since
+    // payload offsets are always 8-byte aligned
+    heap_meta->root = ((offset_t)block->handle << 1) | 1;
+  } else {
+    heap_meta->root = to_offset(payload);
+  }
+  HEAP_UNLOCK();
+}
+
+/*
+ * mm_get_root - Return the current address of the payload registered with
+ *     mm_set_root, or NULL
+ */
+void *mm_get_root(void) {
+  HEAP_LOCK();
+  offset_t root = heap_meta->root;
+  void *payload = NULL;
+  if (root & 1) {
+    offset_t *handles = (void *)heap_meta + heap_meta->handles;
+    payload = to_block(handles[(root >> 1) - 1])->body.payload;
+  } else if (root != NULL_OFFSET) {
+    payload = (void *)heap_meta + root;
+  }
+  HEAP_UNLOCK();
+  return payload;
+}
+
+/*
+ * mm_heap_bounds - Store the first and last byte of the heap in *lo and *hi.
+ *     The refill thread can grow the heap at any time, so callers outside
+ *     mm.c should use this rather than reading mem_heap_hi themselves.
+ */
+void mm_heap_bounds(void **lo, void **hi) {
+  HEAP_LOCK();
+  *lo = heap_meta;
+  *hi = (void *)heap_meta + heap_brk - 1;
+  HEAP_UNLOCK();
+}
 
 /*
  * mm_malloc - Allocate a block with at least size bytes of payload
  */
 /* $begin mmmalloc */
 void *mm_malloc(size_t size) {
+  HEAP_LOCK();
+  void *payload = alloc_payload(size);
+  HEAP_UNLOCK();
+  return payload;
+}
+
+/*
+ * alloc_payload - mm_malloc without the lock
+ */
+static void *alloc_payload(size_t size) {
   uint32_t asize = 0;       /* adjusted block size */
   uint32_t extendsize = 0;  /* amount to extend heap if no fit */
   uint32_t extendwords = 0; /* number of words to extend heap if no fit */
@@ -198,6 +575,7 @@ void *mm_malloc(size_t size) {
   /* Search the free list for a fit */
   if ((block = find_fit(asize)) != NULL) {
     place(block, asize);
+    REFILL_CHECK();
     return block->body.payload;
   }
 
@@ -208,6 +586,7 @@ void *mm_malloc(size_t size) {
   extendwords = extendsize >> 3; // extendsize/8
   if ((block = extend_heap(extendwords)) != NULL) {
     place(block, asize);
+    REFILL_CHECK();
     return block->body.payload;
   }
   /* no more memory :( */
@@ -220,8 +599,19 @@ void *mm_malloc(size_t size) {
  */
 /* $begin mmfree */
 void mm_free(void *payload) {
+  HEAP_LOCK();
+  free_block(payload - sizeof(header_t));
+  HEAP_UNLOCK();
+}
+
+/*
+ * free_block - mm_free without the lock
+ */
+static void free_block(block_t *block) {
+  // Neighbouring boundary tags are read by coalesce after the list push
+  PREFETCH((void *)block - sizeof(footer_t));
+  PREFETCH((void *)block + block->block_size);
   // Set header and footer to free
-  block_t *block = payload - sizeof(header_t);
   block->allocated = FREE;
   footer_t *footer = get_footer(block);
   footer->allocated = FREE;
@@ -242,12 +632,21 @@ void *mm_realloc(void *ptr, size_t size) {
   void *newp = NULL;
   size_t copySize = 0;
 
+  // Same edge cases as realloc(3)
+  if (ptr == NULL) {
+    return mm_malloc(size);
+  }
+  if (size == 0) {
+    mm_free(ptr);
+    return NULL;
+  }
+
   if ((newp = mm_malloc(size)) == NULL) {
     printf("ERROR: mm_malloc failed in mm_realloc\n");
     exit(1);
   }
   block_t *block = ptr - sizeof(header_t);
-  copySize = block->block_size;
+  copySize = block->block_size - OVERHEAD; // payload only
   if (size < copySize) {
     copySize = size;
   }
@@ -256,10 +655,162 @@ void *mm_realloc(void *ptr, size_t size) {
   return newp;
 }
 
+/*
+ * mm_halloc - Allocate a movable block with at least size bytes of payload.
+ *     Returns a handle to pass to mm_hderef, or 0 if out of memory. The
+ *     payload may be moved by mm_compact, so addresses obtained from
+ *     mm_hderef are only valid until the next call to mm_compact.
+ */
+handle_t mm_halloc(size_t size) {
+  HEAP_LOCK();
+  if (heap_meta->handle_free == NULL_HANDLE && grow_handle_table() < 0) {
+    HEAP_UNLOCK();
+    return NULL_HANDLE;
+  }
+
+  void *payload = alloc_payload(size);
+  if (payload == NULL) {
+    HEAP_UNLOCK();
+    return NULL_HANDLE;
+  }
+
+  offset_t *handles = (void *)heap_meta + heap_meta->handles;
+  handle_t handle = heap_meta->handle_free;
+  heap_meta->handle_free = (handle_t)(handles[handle - 1] >> 1);
+
+  block_t *block = payload - sizeof(header_t);
+  block->handle = handle;
+  handles[handle - 1] = to_offset(block);
+  HEAP_UNLOCK();
+  return handle;
+}
+
+/*
+ * mm_hderef - Return the current payload address of a handle
+ */
+void *mm_hderef(handle_t handle) {
+  HEAP_LOCK();
+  offset_t *handles = (void *)heap_meta + heap_meta->handles;
+  void *payload = to_block(handles[handle - 1])->body.payload;
+  HEAP_UNLOCK();
+  return payload;
+}
+
+/*
+ * mm_hfree - Free a block allocated with mm_halloc
+ */
+void mm_hfree(handle_t handle) {
+  HEAP_LOCK();
+  offset_t *handles = (void *)heap_meta + heap_meta->handles;
+  free_block(to_block(handles[handle - 1]));
+
+  handles[handle - 1] = ((offset_t)heap_meta->handle_free << 1) | 1;
+  heap_meta->handle_free = handle;
+  HEAP_UNLOCK();
+}
+
+/*
+ * mm_compact - Slide movable blocks toward the start of the heap, merging the
+ *     free blocks they leave behind. Stops after max_moves blocks have been
+ *     moved or max_blocks blocks have been visited, and the next call resumes
+ *     where this one stopped, so it can be run incrementally at a bounded cost
+ *     per call. Returns the number of blocks moved.
+ */
+size_t mm_compact(size_t max_moves, size_t max_blocks) {
+  HEAP_LOCK();
+  offset_t *handles = (void *)heap_meta + heap_meta->handles;
+  size_t moves = 0;
+  size_t visited = 0;
+
+  block_t *block = (heap_meta->compact_at == NULL_OFFSET)
+                       ? (void *)prologue + prologue->block_size
+                       : to_block(heap_meta->compact_at);
+  while (moves < max_moves && visited < max_blocks) {
+    // A pass that reaches the epilogue starts over from the first block
+    if (block->block_size == 0) {
+      block = (void *)prologue + prologue->block_size;
+      if (block->block_size == 0) {
+        break;
+      }
+    }
+    visited++;
+
+    block_t *next_block = (void *)block + block->block_size;
+
+    // Only a free block directly followed by a movable block can be closed.
+    // The epilogue's handle field is never written, so it is ruled out by size.
+    if (block->allocated || !next_block->allocated ||
+        next_block->block_size == 0 || next_block->handle == NULL_HANDLE) {
+      block = next_block;
+      continue;
+    }
+
+    uint32_t free_size = block->block_size;
+    uint32_t moved_size = next_block->block_size;
+    list_remove(block);
+
+    // Move the whole block, header and footer included, into the hole
+    memmove(block, next_block, moved_size);
+    handles[block->handle - 1] = to_offset(block);
+
+    // The hole now sits after the moved block
+    block_t *hole = (void *)block + moved_size;
+    hole->allocated = FREE;
+    hole->block_size = free_size;
+    footer_t *hole_footer = get_footer(hole);
+    hole_footer->allocated = FREE;
+    hole_footer->block_size = free_size;
+
+    list_push(hole);
+    block = coalesce(hole);
+    moves++;
+  }
+
+  heap_meta->compact_at = (block->block_size == 0) ? NULL_OFFSET
+                                                   : to_offset(block);
+  HEAP_UNLOCK();
+  return moves;
+}
+
+/*
+ * mm_trim - Return the pages backing the free block at the end of the heap to
+ *     the operating system. The block stays in the heap and its pages are
+ *     faulted back in when it is reused: zeroed for a mem_sbrk heap, but
+ *     reread from the file for a file-backed one, since MADV_DONTNEED only
+ *     drops the shared mapping's copy of the pages.
+ */
+void mm_trim(void) {
+  const uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+  block_t *last = NULL;
+
+  HEAP_LOCK();
+  for (block_t *block = prologue; block->block_size > 0;
+       block = (void *)block + block->block_size) {
+    last = block;
+  }
+
+  if (last == NULL || last->allocated) {
+    HEAP_UNLOCK();
+    return;
+  }
+
+  // Keep the header, free list links and footer of the block mapped
+  uintptr_t start = (uintptr_t)last + MIN_BLOCK_SIZE;
+  uintptr_t end = (uintptr_t)get_footer(last);
+  start = (start + page_size - 1) & ~(page_size - 1);
+  end = end & ~(page_size - 1);
+
+  if (start < end) {
+    madvise((void *)start, end - start, MADV_DONTNEED);
+  }
+  HEAP_UNLOCK();
+}
+
 /*
  * mm_checkheap - Check the heap for consistency
  */
 void mm_checkheap(int verbose) {
+  HEAP_LOCK();
   block_t *block = prologue;
 
   if (verbose) {
@@ -271,6 +822,10 @@ void mm_checkheap(int verbose) {
   }
   checkblock(prologue);
 
+  size_t free_bytes = 0;
+  size_t free_blocks = 0;
+  size_t largest_free = 0;
+
   /* iterate through the heap (both free and allocated blocks will be present)
    */
   for (block = (void *)prologue + prologue->block_size; block->block_size > 0;
@@ -279,50 +834,145 @@ void mm_checkheap(int verbose) {
       printblock(block);
     }
     checkblock(block);
+
+    if (!block->allocated) {
+      block_t *next_block = (void *)block + block->block_size;
+      if (!next_block->allocated) {
+        printf("Error: free blocks at %p and %p escaped coalescing\n", block,
+               next_block);
+      }
+      free_bytes += block->block_size;
+      free_blocks++;
+      largest_free =
+          (block->block_size > largest_free) ? block->block_size : largest_free;
+    }
   }
 
   if (verbose) {
     printblock(block);
+    // Fragmentation is the share of free memory outside the largest free block
+    printf("Free: %zu bytes in %zu blocks, largest %zu (%.1f%% fragmented)\n",
+           free_bytes, free_blocks, largest_free,
+           (free_bytes == 0)
+               ? 0.0
+               : 100.0 * (double)(free_bytes - largest_free) / free_bytes);
   }
   if (block->block_size != 0 || !block->allocated) {
     printf("Bad epilogue header\n");
   }
+
+  checklists(free_blocks, free_bytes);
+  HEAP_UNLOCK();
 }
 
 /* The remaining routines are internal helper routines */
 
+// Grows the heap by incr bytes, returning the old break (or UINTPTR_MAX on
+// failure) like mem_sbrk. A file-backed heap grows within its mapping.
+static void *heap_sbrk(int incr) {
+  void *old_brk = NULL;
+
+  if (heap_fd < 0) {
+    old_brk = mem_sbrk(incr);
+    if (old_brk == (void *)UINTPTR_MAX) {
+      return old_brk;
+    }
+  } else {
+    if (incr < 0 || heap_brk + incr > heap_capacity) {
+      return (void *)UINTPTR_MAX;
+    }
+    old_brk = heap_mapping + heap_brk;
+  }
+
+  heap_brk += incr;
+  if (heap_meta != NULL) {
+    heap_meta->heap_size = heap_brk;
+  }
+  return old_brk;
+}
+
+// Converts a heap offset to a block pointer (NULL_OFFSET becomes NULL)
+static block_t *to_block(offset_t offset) {
+  return (offset == NULL_OFFSET) ? NULL : (void *)heap_meta + offset;
+}
+
+// Converts a pointer into the heap to a heap offset (NULL becomes NULL_OFFSET)
+static offset_t to_offset(void *ptr) {
+  return (ptr == NULL) ? NULL_OFFSET : (offset_t)(ptr - (void *)heap_meta);
+}
+
+#ifdef __GNUC__
 // LOG2 macro from https://stackoverflow.com/a/11376759/
 #define LOG2(X)                                                                \
   ((unsigned)(8 * sizeof(unsigned long long) - __builtin_clzll((X)) - 1))
+#else
+// floor(log2(x)) for x > 0 without the builtin, and without a loop: ORing the
+// highest set bit into every bit below it leaves floor(log2(x)) + 1 set bits,
+// which are counted by adding ever wider bit fields in parallel
+static unsigned log2_portable(unsigned long long x) {
+  x |= x >> 1;
+  x |= x >> 2;
+  x |= x >> 4;
+  x |= x >> 8;
+  x |= x >> 16;
+  x |= x >> 32;
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (unsigned)((x * 0x0101010101010101ULL) >> 56) - 1;
+}
 
-// Finds the free list that a block belongs to, returning the head pointer for
-// the free list
-static block_t *which_list(block_t *block) {
-  const uint32_t SMALL_BLOCK = 64;
+#define LOG2(X) log2_portable((X))
+#endif
 
-  uint32_t size = block->block_size;
+// Finds the free list that a block belongs to, returning a pointer to the
+// list's head so that it can be updated in place
+static offset_t *which_list(block_t *block) {
+  return &segregated_lists[list_index(block->block_size)];
+}
+
+// Returns the index of the free list holding blocks of the given size
+static uint32_t list_index(size_t size) {
+  const uint32_t SMALL_BLOCK = 64;
 
   // First 64 lists hold small sizes, specifically 1 byte for the first, 2 bytes
   // for the second, and so on until 64 bytes for the 64th list.
   if (size <= SMALL_BLOCK) {
-    return segregated_lists[size - 1];
+    return size - 1;
   }
 
   uint32_t big_block_idx = LOG2(size - SMALL_BLOCK) + SMALL_BLOCK;
-  big_block_idx = (big_block_idx > LIST_NUM - 1) ? LIST_NUM - 1 : big_block_idx;
+  return (big_block_idx > LIST_NUM - 1) ? LIST_NUM - 1 : big_block_idx;
+}
 
-  return segregated_lists[big_block_idx];
+// Returns the index of the first free list whose blocks are all at least size
+// bytes, or LIST_NUM if there is none. Big list i holds sizes from
+// 64 + 2^(i - 64), so the power of two must be rounded up.
+static uint32_t fit_list_index(size_t size) {
+  const uint32_t SMALL_BLOCK = 64;
+
+  if (size <= SMALL_BLOCK) {
+    return size - 1;
+  }
+
+  size_t excess = size - SMALL_BLOCK;
+  uint32_t big_block_idx =
+      LOG2(excess) + SMALL_BLOCK + ((excess & (excess - 1)) != 0);
+  return (big_block_idx > LIST_NUM - 1) ? LIST_NUM : big_block_idx;
 }
 
 // Pushes a block to the front of an explicit free list
 //
 // Warning: Only use to push free blocks
 static void list_push(block_t *block) {
-  block_t *head = which_list(block);
+  offset_t *head = which_list(block);
+  heap_meta->free_bytes += block->block_size;
 
 #ifdef DEBUG_OUTPUT
   DEBUG_PRINT("list_push");
-  printf("head: %p (%d bytes)\n", head, (head != NULL) ? head->block_size : 0);
+  block_t *head_debug = to_block(*head);
+  printf("head: %p (%d bytes)\n", head_debug,
+         (head_debug != NULL) ? head_debug->block_size : 0);
   printf("block: %p (%d bytes)\n", block,
          (block != NULL) ? block->block_size : 0);
 
@@ -330,20 +980,15 @@ static void list_push(block_t *block) {
   CHECK_EXPLICIT_LIST(LIST_DEPTH);
 #endif
 
-  // Zero elements
-  if (head == NULL) {
-    head = block;
-    block->body.next = NULL;
-    block->body.prev = NULL;
-    return;
-  }
+  block->body.next = *head;
+  block->body.prev = NULL_OFFSET;
 
-  block->body.next = head;
-  block->body.prev = NULL;
-
-  head->body.prev = block;
+  // Zero elements means there is no old head to link back
+  if (*head != NULL_OFFSET) {
+    to_block(*head)->body.prev = to_offset(block);
+  }
 
-  head = block;
+  *head = to_offset(block);
 }
 
 // Removes a block from an explicit free list
@@ -351,57 +996,47 @@ static void list_push(block_t *block) {
 // Warning: Assumes block is in list
 // Warning: Only use to remove allocated blocks
 static void list_remove(block_t *block) {
-  block_t *head = which_list(block);
+  offset_t *head = which_list(block);
 
 #ifdef DEBUG_OUTPUT
   DEBUG_PRINT("list_remove");
-  printf("head: %p (%d bytes)\n", head, (head != NULL) ? head->block_size : 0);
+  block_t *head_debug = to_block(*head);
+  printf("head: %p (%d bytes)\n", head_debug,
+         (head_debug != NULL) ? head_debug->block_size : 0);
   printf("block: %p (%d bytes)\n", block,
          (block != NULL) ? block->block_size : 0);
-  printf(
-      "following: %p (%d bytes)\n", (block != NULL) ? block->body.next : NULL,
-      (block != NULL && block->body.next != NULL) ? block->body.next->block_size
-                                                  : 0);
-  printf(
-      "preceding: %p (%d bytes)\n", (block != NULL) ? block->body.prev : NULL,
-      (block != NULL && block->body.prev != NULL) ? block->body.prev->block_size
-                                                  : 0);
+  block_t *next_debug = (block != NULL) ? to_block(block->body.next) : NULL;
+  block_t *prev_debug = (block != NULL) ? to_block(block->body.prev) : NULL;
+  printf("following: %p (%d bytes)\n", next_debug,
+         (next_debug != NULL) ? next_debug->block_size : 0);
+  printf("preceding: %p (%d bytes)\n", prev_debug,
+         (prev_debug != NULL) ? prev_debug->block_size : 0);
 
   CHECK_EXPLICIT_LIST(LIST_DEPTH);
 #endif
 
-  if (head == NULL || block == NULL) {
-    return;
-  }
-
-  // One-element list
-  if (head->body.next == NULL) {
-    head = NULL;
+  if (*head == NULL_OFFSET || block == NULL) {
     return;
   }
 
-  // Removal block is head
-  // Null check for block->body.next is to satisfy Clang Static Analyzer, in
-  // particular the check `core.NullDereference`. In a correct explicit free
-  // list, a null `head->body.next` implies a null `block->body.next`.
-  if (head == block && block->body.next != NULL) {
-    head = block->body.next;
-    head->body.prev = NULL;
-  }
+  heap_meta->free_bytes -= block->block_size;
 
-  block_t *preceding = block->body.prev;
-  block_t *following = block->body.next;
+  block_t *preceding = to_block(block->body.prev);
+  block_t *following = to_block(block->body.next);
 
+  // Removal block is head when nothing precedes it
   if (preceding != NULL) {
     preceding->body.next = block->body.next;
+  } else {
+    *head = block->body.next;
   }
 
   if (following != NULL) {
     following->body.prev = block->body.prev;
   }
 
-  block->body.next = NULL;
-  block->body.prev = NULL;
+  block->body.next = NULL_OFFSET;
+  block->body.prev = NULL_OFFSET;
 }
 
 /*
@@ -411,13 +1046,28 @@ static block_t *find_fit(size_t asize) {
   DEBUG_PRINT("find_fit");
   CHECK_EXPLICIT_LIST(LIST_DEPTH);
 
-  // Loop through segregated lists to find a useful free block for allocation
-  for (size_t i = asize; i < LIST_NUM; i++) {
-    block_t *head = segregated_lists[i];
+  uint32_t budget = FIT_BUDGET;
+
+  // Loop through segregated lists to find a useful free block for allocation,
+  // giving up on first fit once the budget of inspected blocks is spent
+  for (uint32_t i = list_index(asize); i < LIST_NUM && budget > 0; i++) {
+    block_t *head = to_block(segregated_lists[i]);
+
+#if PREFETCH_DISTANCE > 0
+    // The list heads sit in one array, so the head of a list further on can be
+    // fetched while this one is searched without chasing any link
+    if (i + PREFETCH_DISTANCE < LIST_NUM) {
+      PREFETCH(to_block(segregated_lists[i + PREFETCH_DISTANCE]));
+    }
+#endif
 
     // First-fit search of explicit free list
-    for (block_t *current = head; current != NULL;
-         current = current->body.next) {
+    for (block_t *current = head; current != NULL && budget > 0;
+         current = to_block(current->body.next)) {
+      budget--;
+      // The next node's address is known as soon as this one is loaded; going
+      // further ahead would be a demand load of that node
+      PREFETCH(to_block(current->body.next));
       /* block must be free and the size must be large enough to hold the
        * request
        */
@@ -425,11 +1075,93 @@ static block_t *find_fit(size_t asize) {
         return current;
       }
     }
+  }
+
+  // Any block on a list at or past fit_list_index is large enough, so the
+  // fallback only looks at list heads
+  for (uint32_t i = fit_list_index(asize); i < LIST_NUM; i++) {
+    if (segregated_lists[i] != NULL_OFFSET) {
+      return to_block(segregated_lists[i]);
+    }
+  }
+
+  return NULL; /* no fit */
+}
+
+// Doubles the capacity of the handle table, threading the new entries onto the
+// unused handle list. The table itself is a pinned block in the heap.
+static int grow_handle_table(void) {
+  uint32_t old_cap = heap_meta->handle_cap;
+  uint32_t new_cap = (old_cap == 0) ? HANDLE_TABLE_MIN : old_cap * 2;
+  // Not mm_realloc, which exits when it runs out of memory. The caller holds
+  // heap_lock, hence the unlocked allocation functions.
+  offset_t *handles = alloc_payload(sizeof(offset_t) * new_cap);
+  if (handles == NULL) {
+    return -1;
+  }
+  if (heap_meta->handles != NULL_OFFSET) {
+    void *old_handles = (void *)heap_meta + heap_meta->handles;
+    memcpy(handles, old_handles, sizeof(offset_t) * old_cap);
+    free_block(old_handles - sizeof(header_t));
+  }
 
-    return NULL; /* no fit */
+  for (uint32_t i = old_cap; i < new_cap; i++) {
+    handle_t next_unused = (i + 1 < new_cap) ? i + 2 : heap_meta->handle_free;
+    handles[i] = ((offset_t)next_unused << 1) | 1;
   }
+
+  heap_meta->handles = to_offset(handles);
+  heap_meta->handle_cap = new_cap;
+  heap_meta->handle_free = old_cap + 1;
+  return 0;
 }
 
+#ifdef BACKGROUND_REFILL
+// Starts the refill thread for a freshly initialized or reopened heap
+static void start_refill(void) {
+  refill_stop = false;
+  refill_running =
+      pthread_create(&refill_thread, NULL, refill_main, NULL) == 0;
+}
+
+// Stops the refill thread and waits for it, so the heap can be reinitialized
+// or unmapped under it. Must not be called with heap_lock held.
+static void stop_refill(void) {
+  if (!refill_running) {
+    return;
+  }
+
+  HEAP_LOCK();
+  refill_stop = true;
+  pthread_cond_signal(&refill_cond);
+  HEAP_UNLOCK();
+
+  pthread_join(refill_thread, NULL);
+  refill_running = false;
+}
+
+// Body of the refill thread: grows the heap ahead of demand whenever mm_malloc
+// signals that free space dropped below REFILL_LOW_WATER, so the extend_heap
+// call is usually off the request path. Wakeups, spurious or not, recheck
+// refill_stop before the heap is touched.
+static void *refill_main(void *arg) {
+  (void)arg;
+
+  HEAP_LOCK();
+  while (!refill_stop) {
+    if (heap_meta->free_bytes >= REFILL_LOW_WATER) {
+      pthread_cond_wait(&refill_cond, &heap_lock);
+      continue;
+    }
+    if (extend_heap(CHUNKSIZE >> 3) == NULL) {
+      break; // out of memory; mm_malloc reports it on the request path
+    }
+  }
+  HEAP_UNLOCK();
+  return NULL;
+}
+#endif
+
 /*
  * extend_heap - Extend heap with free block and return its block pointer
  */
@@ -439,7 +1171,7 @@ static block_t *extend_heap(size_t words) {
   block_t *block = NULL;
   uint32_t size = 0;
   size = words << 3; // words*8
-  if (size == 0 || (block = mem_sbrk((int)size)) == (block_t *)UINTPTR_MAX) {
+  if (size == 0 || (block = heap_sbrk((int)size)) == (block_t *)UINTPTR_MAX) {
     return NULL;
   }
   /* The newly acquired region will start directly after the epilogue block */
@@ -473,6 +1205,7 @@ static block_t *extend_heap(size_t words) {
 static void place(block_t *block, size_t asize) {
   size_t split_size = block->block_size - asize;
   list_remove(block);
+  block->handle = NULL_HANDLE;
 
   if (split_size >= MIN_BLOCK_SIZE) {
     /* split the block by updating the header and marking it allocated*/
@@ -516,6 +1249,19 @@ static block_t *coalesce(block_t *block) {
   block_t *prev_block =
       (void *)prev_footer - prev_footer->block_size + sizeof(header_t);
 
+  // Unlinking a free neighbour touches its header and both of its list
+  // neighbours, so start fetching them before the first list_remove. Only
+  // addresses already in hand are prefetched: the previous block's links are
+  // not, since reading them would wait for the block itself, but the next
+  // block's header was just read for next_alloc.
+  if (!prev_alloc) {
+    PREFETCH(prev_block);
+  }
+  if (!next_alloc) {
+    PREFETCH(to_block(next_block->body.next));
+    PREFETCH(to_block(next_block->body.prev));
+  }
+
   if (prev_alloc && next_alloc) { /* Case 1 */
     /* no coalesceing */
     return block;
@@ -562,6 +1308,16 @@ static block_t *coalesce(block_t *block) {
     block = prev_block;
   }
 
+  // The merged block goes back on the list matching its new size
+  list_push(block);
+
+  // mm_compact must not resume from a block that was merged into this one
+  offset_t start = to_offset(block);
+  if (heap_meta->compact_at > start &&
+      heap_meta->compact_at < start + block->block_size) {
+    heap_meta->compact_at = start;
+  }
+
   return block;
 }
 
@@ -601,6 +1357,50 @@ static void checkblock(block_t *block) {
   }
 }
 
+// Checks that the free lists hold exactly the free blocks found by walking the
+// heap, each on the list for its size, with consistent back links
+static void checklists(size_t free_blocks, size_t free_bytes) {
+  void *heap_end = (void *)heap_meta + heap_brk;
+  size_t listed_blocks = 0;
+  size_t listed_bytes = 0;
+
+  for (uint32_t i = 0; i < LIST_NUM; i++) {
+    block_t *prev = NULL;
+
+    // Stop after free_blocks + 1 steps so a cycle cannot hang the checker
+    for (block_t *block = to_block(segregated_lists[i]);
+         block != NULL && listed_blocks <= free_blocks;
+         block = to_block(block->body.next)) {
+      if ((void *)block < (void *)prologue || (void *)block >= heap_end) {
+        printf("Error: list %u links outside the heap (%p)\n", i, block);
+        break;
+      }
+      if (block->allocated) {
+        printf("Error: allocated block %p is on list %u\n", block, i);
+      }
+      if (list_index(block->block_size) != i) {
+        printf("Error: block %p (%d bytes) is on list %u instead of %u\n",
+               block, block->block_size, i, list_index(block->block_size));
+      }
+      if (to_block(block->body.prev) != prev) {
+        printf("Error: block %p has a bad prev link\n", block);
+      }
+      listed_blocks++;
+      listed_bytes += block->block_size;
+      prev = block;
+    }
+  }
+
+  if (listed_blocks != free_blocks) {
+    printf("Error: %zu free blocks in the heap but %zu on the free lists\n",
+           free_blocks, listed_blocks);
+  }
+  if (listed_bytes != heap_meta->free_bytes || free_bytes != listed_bytes) {
+    printf("Error: free byte count is %llu, lists hold %zu, heap holds %zu\n",
+           (unsigned long long)heap_meta->free_bytes, listed_bytes, free_bytes);
+  }
+}
+
 static void debug_print(const char *message) {
   printf("\nDEBUG %s: %d\n", message, global_counter);
   global_counter++;